@@ -5,17 +5,20 @@ namespace phonology {
 class AmericanEnglish : public System<AmericanEnglish> {
   friend class System;
 
-  private:
+ public:
+  // The image compiled from the definitions below when the generator was built
+  static std::span<const std::byte> builtin_image();
+
+ private:
+  using System::System;
   void init_phonemes();
   void init_onsets();
   void init_nuclei();
   void init_codas();
-  std::vector<const Phoneme*> get_onset() const;
-  const Phoneme* get_nucleus(const Phoneme* onset) const;
-  std::vector<const Phoneme*> get_coda(const Phoneme* nucleus) const;
-
-  std::string get_spelling(const Syllable& syllable, bool word_final) const;
-
+  // Three-consonant onsets like /str/ are rarer than their share of the onset table
+  double onset_weight(const Cluster& onset) const {
+    return onset.size() == kMaxClusterSize ? 0.5 : 1;
+  }
 };
 
 }  // namespace phonology
@@ -1,23 +1,464 @@
 #include <benchmark/benchmark.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <ranges>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 
 #include "american_english.hpp"
+#include "constraints.hpp"
+#include "image_language.hpp"
+#include "language.hpp"
 #include "metropolitan_french.hpp"
+#include "mixer.hpp"
+#include "output.hpp"
 #include "phonology.hpp"
+#include "random.hpp"
+#include "records.hpp"
+#include "vocabulary.hpp"
+
+// Count heap allocations so that the appending benchmarks can check that they stay at zero once
+// the output buffers have warmed up
+static std::atomic<std::size_t> allocations = 0;
+
+void* operator new(std::size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void* p = std::malloc(size)) {
+    return p;
+  }
+  std::abort();
+}
+// GCC pairs the malloc above with these frees as a mismatch once they are inlined into library
+// containers, although every allocation goes through both
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+#pragma GCC diagnostic pop
+
+// Runs the benchmark loop over `iteration` after a warm-up that grows every buffer to its working
+// size, reports the allocations made by the loop under `counter`, and fails the benchmark if there
+// are more than `allowed` per iteration
+template <class F>
+static void run_without_allocations(benchmark::State& state, const char* counter, F&& iteration,
+                                    std::size_t allowed = 0) {
+  for (int i = 0; i < 64; ++i) {
+    iteration();
+  }
+  std::size_t before = allocations.load();
+  for (auto _ : state) {
+    iteration();
+  }
+  std::size_t count = allocations.load() - before;
+  state.counters[counter] = benchmark::Counter(count, benchmark::Counter::kAvgIterations);
+  if (count > allowed * state.iterations()) {
+    state.SkipWithError("allocated after warm-up");
+  }
+}
 
 static void BM_french(benchmark::State& state) {
   phonology::MetropolitanFrench mf;
+  phonology::Rng rng(0);
   for (auto _ : state) {
-    benchmark::DoNotOptimize(phonology::get_word(mf, 1));
+    benchmark::DoNotOptimize(phonology::get_word(mf, rng, 1));
   }
 }
 BENCHMARK(BM_french);
 
 static void BM_english(benchmark::State& state) {
   phonology::AmericanEnglish ae;
+  phonology::Rng rng(0);
   for (auto _ : state) {
-    benchmark::DoNotOptimize(phonology::get_word(ae, 1));
+    benchmark::DoNotOptimize(phonology::get_word(ae, rng, 1));
   }
 }
 BENCHMARK(BM_english);
 
+template <class T>
+static void BM_append(benchmark::State& state) {
+  T system;
+  phonology::Rng rng(0);
+  std::string word;
+  word.reserve(256);
+  run_without_allocations(state, "allocs_per_word", [&] {
+    word.clear();
+    phonology::get_word(system, rng, state.range(0), word);
+    benchmark::DoNotOptimize(word.data());
+  });
+}
+BENCHMARK_TEMPLATE(BM_append, phonology::MetropolitanFrench)->Arg(1)->Arg(4);
+BENCHMARK_TEMPLATE(BM_append, phonology::AmericanEnglish)->Arg(1)->Arg(4);
+
+// The same words followed by their transcription with syllable boundaries
+template <class T>
+static void BM_append_ipa(benchmark::State& state) {
+  T system;
+  phonology::Rng rng(0);
+  std::string word;
+  word.reserve(256);
+  run_without_allocations(state, "allocs_per_word", [&] {
+    word.clear();
+    phonology::get_word(system, rng, state.range(0), word,
+                        phonology::Transcription::IPA_SYLLABLES);
+    benchmark::DoNotOptimize(word.data());
+  });
+}
+BENCHMARK_TEMPLATE(BM_append_ipa, phonology::MetropolitanFrench)->Arg(1)->Arg(4);
+BENCHMARK_TEMPLATE(BM_append_ipa, phonology::AmericanEnglish)->Arg(1)->Arg(4);
+
+// Batches of word records, with the structure of every word alongside its spelling
+template <class T>
+static void BM_get_record(benchmark::State& state) {
+  T system;
+  phonology::Rng rng(0);
+  phonology::RecordBatch batch;
+  run_without_allocations(state, "allocs_per_batch", [&] {
+    batch.clear();
+    for (int i = 0; i < 1024; ++i) {
+      phonology::get_record(system, rng, state.range(0), batch);
+    }
+    benchmark::DoNotOptimize(batch.chars.data());
+  });
+  state.SetItemsProcessed(state.iterations() * 1024);
+}
+BENCHMARK_TEMPLATE(BM_get_record, phonology::MetropolitanFrench)->Arg(1)->Arg(4);
+BENCHMARK_TEMPLATE(BM_get_record, phonology::AmericanEnglish)->Arg(1)->Arg(4);
+
+// Reading batches back from a record stream and printing them as text. The stream is first
+// checked to read back as the words get_word transcribes from the same draws.
+template <class T>
+static void BM_read_records(benchmark::State& state) {
+  T system;
+  char path[] = "/tmp/phonology_recordsXXXXXX";
+  int fd = mkstemp(path);
+  close(fd);
+  std::string expected;
+  {
+    phonology::OutputWriter out(path);
+    phonology::Rng record_rng(0);
+    phonology::Rng word_rng(0);
+    phonology::RecordBatch batch;
+    for (int b = 0; b < 4; ++b) {
+      batch.clear();
+      for (int i = 0; i < 1024; ++i) {
+        phonology::get_record(system, record_rng, state.range(0), batch);
+        phonology::get_word(system, word_rng, state.range(0), expected,
+                            phonology::Transcription::IPA_SYLLABLES);
+        expected += '\n';
+      }
+      batch.write(out);
+    }
+  }
+  phonology::Image stream = phonology::Image::map_stream(path);
+  unlink(path);
+  std::string text;
+  auto read = [&] {
+    text.clear();
+    phonology::RecordView batch;
+    for (std::span<const std::byte> rest = stream.bytes(); !rest.empty();) {
+      std::span<const std::byte> image = phonology::Image::next(rest);
+      rest = rest.subspan(image.size());
+      if (!batch.read(image)) {
+        return false;
+      }
+      for (std::size_t i = 0; i < batch.size(); ++i) {
+        batch.transcribe(i, text);
+        text += '\n';
+      }
+    }
+    return true;
+  };
+  if (!read() || text != expected) {
+    state.SkipWithError("records do not read back as written");
+    return;
+  }
+  for (auto _ : state) {
+    read();
+    benchmark::DoNotOptimize(text.data());
+  }
+  state.SetItemsProcessed(state.iterations() * 4 * 1024);
+}
+BENCHMARK_TEMPLATE(BM_read_records, phonology::MetropolitanFrench)->Arg(1)->Arg(4);
+BENCHMARK_TEMPLATE(BM_read_records, phonology::AmericanEnglish)->Arg(1)->Arg(4);
+
+template <class T>
+static void BM_generate_batch(benchmark::State& state) {
+  T system;
+  phonology::Rng rng(0);
+  phonology::WordBatch batch;
+  run_without_allocations(state, "allocs_per_batch", [&] {
+    batch.clear();
+    phonology::generate_batch(system, rng, 1024, state.range(0), batch);
+    benchmark::DoNotOptimize(batch.chars.data());
+  });
+  state.SetItemsProcessed(state.iterations() * 1024);
+  state.SetBytesProcessed(state.iterations() * batch.chars.size());
+}
+BENCHMARK_TEMPLATE(BM_generate_batch, phonology::MetropolitanFrench)->Arg(1)->Arg(4);
+BENCHMARK_TEMPLATE(BM_generate_batch, phonology::AmericanEnglish)->Arg(1)->Arg(4);
+
+// The same batches through a Language picked at runtime, which costs one virtual call per batch
+static void BM_language_batch(benchmark::State& state, std::string_view tag) {
+  auto language = phonology::Language::make(tag);
+  phonology::Rng rng(0);
+  phonology::WordBatch batch;
+  for (auto _ : state) {
+    batch.clear();
+    language->generate_batch(rng, 1024, state.range(0), batch);
+    benchmark::DoNotOptimize(batch.chars.data());
+  }
+  state.SetItemsProcessed(state.iterations() * 1024);
+}
+BENCHMARK_CAPTURE(BM_language_batch, fr-FR, "fr-FR")->Arg(1)->Arg(4);
+BENCHMARK_CAPTURE(BM_language_batch, en-US, "en-US")->Arg(1)->Arg(4);
+
+// Batches interleaving both languages half and half, each word tagged with its language
+static void BM_mixer_batch(benchmark::State& state) {
+  std::vector<phonology::Mixer::Component> components;
+  components.push_back({phonology::Language::make("en-US"), 1});
+  components.push_back({phonology::Language::make("fr-FR"), 1});
+  phonology::Mixer mixer(std::move(components), true);
+  phonology::Rng rng(0);
+  phonology::WordBatch batch;
+  run_without_allocations(state, "allocs_per_batch", [&] {
+    batch.clear();
+    mixer.generate_batch(rng, 1024, state.range(0), batch);
+    benchmark::DoNotOptimize(batch.chars.data());
+  });
+  state.SetItemsProcessed(state.iterations() * 1024);
+}
+BENCHMARK(BM_mixer_batch)->Arg(1)->Arg(4);
+
+// Words of 6 to 8 letters pulled through a range pipeline. The only allocation is the buffer of
+// the range itself, once per batch.
+template <class T>
+static void BM_words_filtered(benchmark::State& state) {
+  T system;
+  phonology::Rng rng(0);
+  auto in_length = [](std::string_view word) { return word.size() >= 6 && word.size() <= 8; };
+  run_without_allocations(
+      state, "allocs_per_batch",
+      [&] {
+        for (std::string_view word :
+             phonology::words(system, rng, state.range(0)) | std::views::filter(in_length) |
+                 std::views::take(1024)) {
+          benchmark::DoNotOptimize(word.data());
+        }
+      },
+      1);
+  state.SetItemsProcessed(state.iterations() * 1024);
+}
+BENCHMARK_TEMPLATE(BM_words_filtered, phonology::MetropolitanFrench)->Arg(2)->Arg(4);
+BENCHMARK_TEMPLATE(BM_words_filtered, phonology::AmericanEnglish)->Arg(2)->Arg(4);
+
+// The same words drawn under constraints instead (second argument 0), and words with a prefix and
+// a suffix, which filtering would rarely find (1)
+template <class T>
+static void BM_constrained(benchmark::State& state) {
+  static const phonology::Constraints kConstraints[] = {
+      {.min_length = 6, .max_length = 8},
+      {.prefix = "pla", .suffix = "e"},
+  };
+  T system;
+  phonology::Constrained<T> constrained(system, kConstraints[state.range(1)]);
+  phonology::Rng rng(0);
+  std::string word;
+  for (auto _ : state) {
+    word.clear();
+    benchmark::DoNotOptimize(constrained.get_word(rng, state.range(0), word));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_constrained, phonology::MetropolitanFrench)
+    ->Args({2, 0})
+    ->Args({4, 0})
+    ->Args({4, 1});
+BENCHMARK_TEMPLATE(BM_constrained, phonology::AmericanEnglish)
+    ->Args({2, 0})
+    ->Args({4, 0})
+    ->Args({4, 1});
+
+// Per-stage benchmarks, going through System as get_word does. Inputs to a stage are drawn up
+// front from the earlier stages and cycled through, so each loop times only the stage itself.
+constexpr std::size_t kNumInputs = 1024;
+
+template <class T>
+static std::vector<phonology::Syllable> make_syllables(const phonology::System<T>& system,
+                                                      phonology::Rng& rng) {
+  std::vector<phonology::Syllable> syllables(kNumInputs);
+  for (auto& syllable : syllables) {
+    syllable.onset = system.get_onset(rng);
+    syllable.nucleus = system.get_nucleus(syllable.onset.back(), rng);
+    syllable.coda = system.get_coda(syllable.nucleus, rng);
+  }
+  return syllables;
+}
+
+// Constructing a built-in language, which uses the image linked into read-only data in place
+template <class T>
+static void BM_construct(benchmark::State& state) {
+  run_without_allocations(state, "allocs_per_system", [] {
+    T system;
+    benchmark::DoNotOptimize(&system);
+  });
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_construct, phonology::MetropolitanFrench);
+BENCHMARK_TEMPLATE(BM_construct, phonology::AmericanEnglish);
+
+// Building that image from the definitions, as the build does
+template <class T>
+static void BM_compile_definitions(benchmark::State& state) {
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(T::compile_definitions());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_compile_definitions, phonology::MetropolitanFrench);
+BENCHMARK_TEMPLATE(BM_compile_definitions, phonology::AmericanEnglish);
+
+// Loading the same system from a saved image, which maps the file and checks the tables instead
+// of building them
+template <class T>
+static void BM_load_image(benchmark::State& state) {
+  char path[] = "/tmp/phonology_imageXXXXXX";
+  int fd = mkstemp(path);
+  close(fd);
+  T().save(path);
+  for (auto _ : state) {
+    phonology::ImageLanguage system(path);
+    benchmark::DoNotOptimize(&system);
+  }
+  unlink(path);
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_load_image, phonology::MetropolitanFrench);
+BENCHMARK_TEMPLATE(BM_load_image, phonology::AmericanEnglish);
+
+template <class T>
+static void BM_get_onset(benchmark::State& state) {
+  T language;
+  const phonology::System<T>& system = language;
+  phonology::Rng rng(0);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(system.get_onset(rng));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_get_onset, phonology::MetropolitanFrench);
+BENCHMARK_TEMPLATE(BM_get_onset, phonology::AmericanEnglish);
+
+template <class T>
+static void BM_get_nucleus(benchmark::State& state) {
+  T language;
+  const phonology::System<T>& system = language;
+  phonology::Rng rng(0);
+  auto syllables = make_syllables(system, rng);
+  std::size_t i = 0;
+  for (auto _ : state) {
+    const auto& onset = syllables[i++ % kNumInputs].onset;
+    benchmark::DoNotOptimize(system.get_nucleus(onset.back(), rng));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_get_nucleus, phonology::MetropolitanFrench);
+BENCHMARK_TEMPLATE(BM_get_nucleus, phonology::AmericanEnglish);
+
+template <class T>
+static void BM_get_coda(benchmark::State& state) {
+  T language;
+  const phonology::System<T>& system = language;
+  phonology::Rng rng(0);
+  auto syllables = make_syllables(system, rng);
+  std::size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(system.get_coda(syllables[i++ % kNumInputs].nucleus, rng));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_get_coda, phonology::MetropolitanFrench);
+BENCHMARK_TEMPLATE(BM_get_coda, phonology::AmericanEnglish);
+
+template <class T>
+static void BM_get_spelling(benchmark::State& state) {
+  T language;
+  const phonology::System<T>& system = language;
+  phonology::Rng rng(0);
+  auto syllables = make_syllables(system, rng);
+  std::string out;
+  std::size_t i = 0;
+  std::size_t bytes = 0;
+  for (auto _ : state) {
+    out.clear();
+    system.get_spelling(syllables[i % kNumInputs], i % 2, rng, out);
+    benchmark::DoNotOptimize(out.data());
+    bytes += out.size();
+    ++i;
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(bytes);
+}
+BENCHMARK_TEMPLATE(BM_get_spelling, phonology::MetropolitanFrench);
+BENCHMARK_TEMPLATE(BM_get_spelling, phonology::AmericanEnglish);
+
+// Whole words over a range of lengths. The threaded variants share one System, as the
+// generator's --threads mode does.
+template <class T>
+static void BM_get_word(benchmark::State& state) {
+  static const T system;
+  phonology::Rng rng(state.thread_index());
+  for (int i = 0; i < state.thread_index(); ++i) {
+    rng.jump();
+  }
+  std::string word;
+  std::size_t bytes = 0;
+  for (auto _ : state) {
+    word.clear();
+    phonology::get_word(system, rng, state.range(0), word);
+    benchmark::DoNotOptimize(word.data());
+    bytes += word.size();
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(bytes);
+}
+BENCHMARK_TEMPLATE(BM_get_word, phonology::MetropolitanFrench)->DenseRange(1, 8);
+BENCHMARK_TEMPLATE(BM_get_word, phonology::AmericanEnglish)->DenseRange(1, 8);
+BENCHMARK_TEMPLATE(BM_get_word, phonology::MetropolitanFrench)
+    ->Arg(4)
+    ->Threads(2)
+    ->Threads(4)
+    ->Threads(8)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_get_word, phonology::AmericanEnglish)
+    ->Arg(4)
+    ->Threads(2)
+    ->Threads(4)
+    ->Threads(8)
+    ->UseRealTime();
+
+// Random access into the numbered vocabulary. The counts are cached before timing starts.
+template <class T>
+static void BM_word_at(benchmark::State& state) {
+  T system;
+  phonology::Vocabulary vocabulary(system, state.range(0));
+  phonology::FeistelPermutation permutation(vocabulary.num_words(), 0);
+  std::string word;
+  uint64_t i = 0;
+  for (auto _ : state) {
+    word.clear();
+    vocabulary.word_at(permutation(i++), word);
+    benchmark::DoNotOptimize(word.data());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_word_at, phonology::MetropolitanFrench)->Arg(1)->Arg(3);
+BENCHMARK_TEMPLATE(BM_word_at, phonology::AmericanEnglish)->Arg(1)->Arg(3);
+
 BENCHMARK_MAIN();
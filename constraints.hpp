@@ -0,0 +1,723 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <numeric>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "phonology.hpp"
+#include "random.hpp"
+
+namespace phonology {
+
+// Draws words of a system that meet Constraints. Instead of drawing whole words and throwing
+// most of them away, choices that cannot lead to an acceptable word are pruned while the word is
+// built: the number of syllables and each onset, nucleus and coda are only drawn among those whose
+// possible letter counts, precomputed exactly for the contexts they are spelled in, can still add
+// up to an acceptable length, and each spelling is checked against the constraints themselves.
+// The first syllable likewise only takes an onset and a nucleus that can begin the prefix. A
+// syllable that still runs into a dead end, as when spellings of other lengths were picked
+// before, is drawn again, and a word whose syllable keeps doing so is started over.
+//
+// The words follow get_word's distribution conditioned on the constraints only roughly, since
+// pruned choices hand their weight to the ones left beside them rather than to the whole word:
+// early syllables are drawn as if any later ones fitting were as likely as any other, which
+// favours the longest acceptable words. Only reads the system, so one instance can be shared
+// between threads.
+template <class T>
+class Constrained {
+ public:
+  static constexpr int kMaxAttempts = 1 << 16;
+
+  Constrained(const System<T>& system, Constraints constraints);
+
+  // Appends a word meeting the constraints to out. Returns false, leaving out as it was, if none
+  // turned up in kMaxAttempts tries, as when the constraints cannot be met.
+  bool get_word(Rng& rng, int max_num_syllables, std::string& out) const;
+
+ private:
+  static constexpr int kSyllableAttempts = 16;
+  // Draws from a whole distribution tried before picking among the clusters that fit
+  static constexpr int kDraws = 4;
+  static constexpr std::size_t kNone = SIZE_MAX;
+  static constexpr std::size_t kNumPrev = kNumContexts / Context::kNumNext;
+
+  // Sets of letter counts. Counts are exact below threshold, which stands for itself and every
+  // larger count, as the constraints no longer tell those apart. Wide enough that a set shifted
+  // up by any count up to threshold keeps all its bits.
+  static constexpr std::size_t kMaxThreshold = 63;
+  using LengthSet = std::bitset<2 * kMaxThreshold + 2>;
+  LengthSet saturate(LengthSet set) const {
+    if ((set >> threshold).any()) {
+      set &= ~(~LengthSet() << threshold);
+      set.set(threshold);
+    }
+    return set;
+  }
+  // The counts of a followed by those of b
+  LengthSet then(const LengthSet& a, const LengthSet& b) const {
+    LengthSet sum;
+    for (std::size_t i = 0; i <= threshold; ++i) {
+      if (a[i]) {
+        sum |= b << i;
+      }
+    }
+    return saturate(sum);
+  }
+  // The counts that can follow some count of before, which lies within bounds, to land in
+  // allowed. Above threshold, allowed must have every bit set or none.
+  LengthSet left_after(const LengthSet& allowed, const LengthSet& before, Lengths bounds) const {
+    LengthSet rest;
+    if (before.none()) {
+      return rest;
+    }
+    for (std::size_t i = std::min(bounds.min, threshold); i <= std::min(bounds.max, threshold);
+         ++i) {
+      if (before[i]) {
+        rest |= allowed >> i;
+      }
+    }
+    return rest;
+  }
+  // The counts a syllable can take after used letters, with remaining syllables to follow it
+  LengthSet syllable_allowed(std::size_t used, std::size_t remaining) const;
+
+  // Appends a syllable of a count of letters in allowed, followed by after more letters, or
+  // returns false after kSyllableAttempts dead ends
+  bool get_syllable(bool word_final, const LengthSet& allowed, Lengths after, Rng& rng,
+                    std::string& out, Draft& draft) const;
+
+  // The clusters of one distribution, in classes of equal letter counts and equal context for
+  // what follows, so that a draw among the clusters that fit picks one of the classes that do by
+  // probability, then a cluster within it
+  struct Classes {
+    std::vector<LengthSet> sets;
+    std::vector<uint8_t> nexts;
+    std::vector<double> p;
+    // The clusters of class k are [offsets[k], offsets[k + 1]), drawn by samplers at the same
+    // offsets. Past them, samplers draws from all the clusters, whose classes are class_of.
+    std::vector<uint16_t> clusters;
+    std::vector<uint16_t> offsets = {0};
+    std::vector<uint16_t> class_of;
+    AliasTablesBuilder samplers;
+
+    // Sorts clusters with probabilities p into classes by sets and nexts, all four parallel
+    Classes(std::span<const std::size_t> clusters, std::span<const double> p,
+            std::span<const LengthSet> sets, std::span<const uint8_t> nexts);
+    // A cluster of a class that shares a count with allowed[next of the class], or kNone if none
+    // does
+    std::size_t draw(std::span<const LengthSet> allowed, Rng& rng) const;
+  };
+  // The clusters of a group of the table, or of the whole table past the last group, by their
+  // sets and nexts
+  Classes classify(const ClusterTable& table, std::size_t group, std::span<const LengthSet> sets,
+                   std::span<const uint8_t> nexts) const;
+  // Where the classes of a group drawn from after a cluster of PrevClass prev lie
+  static std::size_t in_context(std::size_t group, std::size_t prev, bool word_final) {
+    return (group * kNumPrev + prev) * 2 + word_final;
+  }
+  bool accepts(std::string_view word) const {
+    return word.size() >= constraints.min_length && word.size() <= constraints.max_length &&
+           word.starts_with(constraints.prefix) && word.ends_with(constraints.suffix);
+  }
+  std::vector<Lengths> cluster_lengths(const ClusterTable& table) const;
+  // Whether some spellings of phonemes, in any context, can spell the prefix from position at on
+  // or spell a start of it
+  bool can_begin_prefix(std::span<const uint8_t> phonemes, std::size_t at) const;
+
+  const System<T>& system;
+  Constraints constraints;
+  std::bitset<256> alphabet;
+  // Letters the spellings of each phoneme made of the alphabet take, in any context
+  std::vector<Lengths> phoneme_lengths;
+  // Letters each cluster of the onset, nucleus and coda tables takes
+  std::vector<Lengths> onset_lengths;
+  std::vector<Lengths> nucleus_lengths;
+  std::vector<Lengths> coda_lengths;
+  // Letters any syllable takes, not counting extra final letters
+  Lengths syllable_lengths;
+
+  std::size_t threshold;
+  // Exact counts of the letters of each cluster, as the Lengths above bound them, in every
+  // context it is spelled in: onsets by the NextClass of the nucleus, nuclei by their Context and
+  // codas by the PrevClass of the nucleus and whether they end the word
+  std::vector<std::array<LengthSet, Context::kNumNext>> onset_sets;
+  std::vector<std::array<LengthSet, kNumContexts>> nucleus_sets;
+  std::vector<std::array<LengthSet, 2 * kNumPrev>> coda_sets;
+  // The PrevClass of the last phoneme of each onset and of each nucleus, and the NextClass of
+  // each nucleus and of the first phoneme of each coda
+  std::vector<uint8_t> onset_prev;
+  std::vector<uint8_t> nucleus_prev;
+  std::vector<uint8_t> nucleus_next;
+  std::vector<uint8_t> coda_next;
+  // For r more syllables, the letter counts so far from which the word can still reach an
+  // acceptable length. The last entry holds for every larger r too.
+  std::vector<LengthSet> can_end;
+  // The distributions get_syllable draws from, for a syllable that does not end the word and for
+  // one that does: onsets from the whole table, and at in_context, nuclei from their group and
+  // codas from their group or the whole table
+  std::vector<Classes> onsets;
+  std::vector<Classes> nuclei;
+  std::vector<Classes> codas;
+  // The onsets that can begin the prefix, drawn from instead of the whole onset table for the
+  // first syllable, with the probabilities they have there, and after each, from
+  // initial_nuclei_at[onset] on, the nuclei that can go on with it. Empty without a prefix.
+  std::vector<Classes> initial_onsets;
+  std::vector<Classes> initial_nuclei;
+  std::vector<std::size_t> initial_nuclei_at;
+};
+
+template <class T>
+Constrained<T>::Constrained(const System<T>& system, Constraints constraints)
+    : system(system), constraints(std::move(constraints)) {
+  if (this->constraints.alphabet.empty()) {
+    alphabet.set();
+  }
+  for (char c : this->constraints.alphabet) {
+    alphabet.set(static_cast<unsigned char>(c));
+  }
+  const SpellingTable& spellings = system.spelling_table;
+  for (std::size_t p = 0; p < system.phonemes.size(); ++p) {
+    Lengths lengths;
+    for (std::size_t i = 0; i < spellings.num_spellings(p); ++i) {
+      std::string_view s = spellings.spelling(p, i);
+      bool usable =
+          std::ranges::all_of(s, [&](char c) { return alphabet[static_cast<unsigned char>(c)]; });
+      if (usable) {
+        lengths = lengths | Lengths{s.size(), s.size()};
+      }
+    }
+    phoneme_lengths.push_back(lengths);
+  }
+  onset_lengths = cluster_lengths(system.onset_table);
+  nucleus_lengths = cluster_lengths(system.nucleus_table);
+  coda_lengths = cluster_lengths(system.coda_table);
+
+  Lengths any_onset;
+  for (Lengths l : onset_lengths) {
+    any_onset = any_onset | l;
+  }
+  Lengths any_nucleus;
+  for (Lengths l : nucleus_lengths) {
+    any_nucleus = any_nucleus | l;
+  }
+  Lengths any_coda = {0, 0};
+  for (Lengths l : coda_lengths) {
+    any_coda = any_coda | l;
+  }
+  syllable_lengths = any_onset + any_nucleus + any_coda;
+
+  // Past max_length every count is too long, and with no maximum, past min_length every count is
+  // long enough. Beyond kMaxThreshold the sets give up on the maximum, and drawn words are only
+  // checked once complete.
+  const std::size_t min_length = this->constraints.min_length;
+  const std::size_t max_length = this->constraints.max_length;
+  LengthSet acceptable;
+  if (max_length < kMaxThreshold) {
+    threshold = max_length + 1;
+    for (std::size_t n = min_length; n <= max_length; ++n) {
+      acceptable.set(n);
+    }
+  } else {
+    threshold = std::min(min_length, kMaxThreshold);
+    acceptable.set(threshold);
+  }
+
+  // The letters of phoneme p spelled in a context, and of a cluster spelled after prev and before
+  // next
+  const auto phone = [&](uint8_t p) { return &system.phonemes[p].p; };
+  const auto spelled = [&](uint8_t p, Context context) {
+    LengthSet set;
+    for (uint8_t i : spellings.get(p, context)) {
+      std::string_view s = spellings.spelling(p, i);
+      if (std::ranges::all_of(s, [&](char c) { return alphabet[static_cast<unsigned char>(c)]; })) {
+        set.set(std::min(s.size(), threshold));
+      }
+    }
+    return set;
+  };
+  const auto cluster_set = [&](std::span<const uint8_t> cluster, PrevClass prev, NextClass next) {
+    LengthSet set = LengthSet().set(0);
+    for (std::size_t i = 0; i < cluster.size(); ++i) {
+      const Context context = {
+          i ? Context::prev_class(phone(cluster[i - 1])) : prev,
+          i + 1 < cluster.size() ? Context::next_class(phone(cluster[i + 1]), false) : next};
+      set = then(set, spelled(cluster[i], context));
+    }
+    return set;
+  };
+  constexpr NextClass kEnd[] = {NextClass::SYLLABLE_END, NextClass::WORD_END};
+
+  const ClusterTable& onsets = system.onset_table;
+  const ClusterTable& nuclei = system.nucleus_table;
+  const ClusterTable& codas = system.coda_table;
+  for (std::size_t onset = 0; onset < onsets.num_clusters(); ++onset) {
+    const Phone* last = phone(onsets.get(onset).back());
+    onset_prev.push_back(static_cast<uint8_t>(Context::prev_class(last)));
+  }
+  for (std::size_t nucleus = 0; nucleus < nuclei.num_clusters(); ++nucleus) {
+    const Phone* p = phone(nuclei.get(nucleus).front());
+    nucleus_prev.push_back(static_cast<uint8_t>(Context::prev_class(p)));
+    nucleus_next.push_back(static_cast<uint8_t>(Context::next_class(p, false)));
+  }
+  for (std::size_t coda = 0; coda < codas.num_clusters(); ++coda) {
+    const Phone* first = phone(codas.get(coda).front());
+    coda_next.push_back(static_cast<uint8_t>(Context::next_class(first, false)));
+  }
+  // Only the contexts a cluster can be spelled in get sets; the others stay empty, so that
+  // get_syllable passes over them quickly
+  for (std::size_t onset = 0; onset < onsets.num_clusters(); ++onset) {
+    const std::size_t group = system.nucleus_group[onsets.get(onset).back()];
+    onset_sets.emplace_back();
+    for (std::size_t i = 0; i < nuclei.group_size(group); ++i) {
+      const uint8_t next = nucleus_next[nuclei.group_offset(group) + i];
+      if (onset_sets.back()[next].none()) {
+        onset_sets.back()[next] =
+            cluster_set(onsets.get(onset), PrevClass::NONE, static_cast<NextClass>(next));
+      }
+    }
+  }
+  for (std::size_t nucleus = 0; nucleus < nuclei.num_clusters(); ++nucleus) {
+    const uint8_t p = nuclei.get(nucleus).front();
+    std::bitset<Context::kNumNext> nexts;
+    for (std::size_t coda = 0; coda < codas.num_clusters(); ++coda) {
+      if (system.coda_group[p] == System<T>::kAnyGroup ||
+          codas.group_of(coda) == system.coda_group[p]) {
+        nexts.set(coda_next[coda]);
+      }
+    }
+    if (!system.nuclei_requiring_coda[p]) {
+      nexts.set(static_cast<std::size_t>(NextClass::SYLLABLE_END));
+      nexts.set(static_cast<std::size_t>(NextClass::WORD_END));
+    }
+    nucleus_sets.emplace_back();
+    for (uint8_t c = 0; c < kNumContexts; ++c) {
+      const Context context = Context::from_index(c);
+      if (nexts[static_cast<std::size_t>(context.next)]) {
+        nucleus_sets.back()[c] = cluster_set(nuclei.get(nucleus), context.prev, context.next);
+      }
+    }
+  }
+  for (std::size_t coda = 0; coda < codas.num_clusters(); ++coda) {
+    coda_sets.emplace_back();
+    for (std::size_t prev = 0; prev < kNumPrev; ++prev) {
+      for (bool word_final : {false, true}) {
+        coda_sets.back()[prev * 2 + word_final] =
+            cluster_set(codas.get(coda), static_cast<PrevClass>(prev), kEnd[word_final]);
+      }
+    }
+  }
+
+  // The codas each nucleus can take, as sample_coda draws them, by the NextClass they set for it,
+  // and on to the rest of the syllable from each nucleus and to whole syllables
+  std::vector<std::array<LengthSet, 2 * kNumPrev * Context::kNumNext>> group_codas(
+      codas.num_groups() + 1);
+  for (std::size_t coda = 0; coda < codas.num_clusters(); ++coda) {
+    for (std::size_t i = 0; i < 2 * kNumPrev; ++i) {
+      const std::size_t at = i * Context::kNumNext + coda_next[coda];
+      group_codas[codas.group_of(coda)][at] |= coda_sets[coda][i];
+      group_codas.back()[at] |= coda_sets[coda][i];
+    }
+  }
+  std::vector<std::array<LengthSet, 2 * kNumPrev>> nucleus_rest(nuclei.num_clusters());
+  for (std::size_t nucleus = 0; nucleus < nuclei.num_clusters(); ++nucleus) {
+    const uint8_t p = nuclei.get(nucleus).front();
+    const std::size_t group =
+        system.coda_group[p] == System<T>::kAnyGroup ? codas.num_groups() : system.coda_group[p];
+    for (std::size_t prev = 0; prev < kNumPrev; ++prev) {
+      for (bool word_final : {false, true}) {
+        const auto& sets = nucleus_sets[nucleus];
+        const std::size_t coda_prev = nucleus_prev[nucleus] * 2 + word_final;
+        LengthSet& rest = nucleus_rest[nucleus][prev * 2 + word_final];
+        for (std::size_t next = 0; next < Context::kNumNext; ++next) {
+          const LengthSet& coda = group_codas[group][coda_prev * Context::kNumNext + next];
+          rest |= then(sets[prev * Context::kNumNext + next], coda);
+        }
+        if (!system.nuclei_requiring_coda[p]) {
+          rest |= sets[Context{static_cast<PrevClass>(prev), kEnd[word_final]}.index()];
+        }
+      }
+    }
+  }
+  std::vector<LengthSet> onset_rest[2];
+  LengthSet syllable[2];
+  for (std::size_t onset = 0; onset < onsets.num_clusters(); ++onset) {
+    const std::size_t group = system.nucleus_group[onsets.get(onset).back()];
+    for (bool word_final : {false, true}) {
+      LengthSet rest;
+      for (std::size_t i = 0; i < nuclei.group_size(group); ++i) {
+        const std::size_t nucleus = nuclei.group_offset(group) + i;
+        rest |= then(onset_sets[onset][nucleus_next[nucleus]],
+                     nucleus_rest[nucleus][onset_prev[onset] * 2 + word_final]);
+      }
+      onset_rest[word_final].push_back(rest);
+      syllable[word_final] |= rest;
+    }
+  }
+
+  // Letters of r more syllables, the last of which ends the word, until adding a syllable no
+  // longer changes them: at the latest once every count has reached threshold, or, when a
+  // syllable can take no letters, once the growing set stops growing. The silent letters a word
+  // can end in are left out, as the spelling only adds them half the time.
+  LengthSet tail = LengthSet().set(0);
+  for (std::size_t r = 0;; ++r) {
+    LengthSet ends;
+    for (std::size_t used = 0; used <= threshold; ++used) {
+      ends[used] = (saturate(tail << used) & acceptable).any();
+    }
+    can_end.push_back(ends);
+    LengthSet next = then(syllable[r == 0], tail);
+    if (r > 0 && next == tail) {
+      break;
+    }
+    tail = next;
+  }
+
+  const std::vector<uint8_t> no_nexts(onsets.num_clusters());
+  for (bool word_final : {false, true}) {
+    this->onsets.push_back(classify(onsets, onsets.num_groups(), onset_rest[word_final], no_nexts));
+  }
+  std::vector<LengthSet> sets;
+  for (std::size_t group = 0; group < nuclei.num_groups(); ++group) {
+    for (std::size_t prev = 0; prev < kNumPrev; ++prev) {
+      for (bool word_final : {false, true}) {
+        sets.clear();
+        for (const auto& rest : nucleus_rest) {
+          sets.push_back(rest[prev * 2 + word_final]);
+        }
+        this->nuclei.push_back(classify(nuclei, group, sets, nucleus_next));
+      }
+    }
+  }
+  for (std::size_t group = 0; group <= codas.num_groups(); ++group) {
+    for (std::size_t prev = 0; prev < kNumPrev; ++prev) {
+      for (bool word_final : {false, true}) {
+        sets.clear();
+        for (const auto& set : coda_sets) {
+          sets.push_back(set[prev * 2 + word_final]);
+        }
+        this->codas.push_back(classify(codas, group, sets, coda_next));
+      }
+    }
+  }
+
+  if (!this->constraints.prefix.empty()) {
+    std::vector<double> onset_p = onsets.probabilities();
+    std::vector<std::size_t> initial;
+    std::vector<double> weights;
+    std::vector<LengthSet> rest[2];
+    std::vector<std::size_t> continuing;
+    std::vector<uint8_t> phonemes;
+    initial_nuclei_at.resize(onsets.num_clusters(), kNone);
+    for (std::size_t onset = 0; onset < onset_p.size(); ++onset) {
+      const std::size_t group = system.nucleus_group[onsets.get(onset).back()];
+      continuing.clear();
+      for (std::size_t i = 0; i < nuclei.group_size(group); ++i) {
+        const std::size_t nucleus = nuclei.group_offset(group) + i;
+        phonemes.assign(onsets.get(onset).begin(), onsets.get(onset).end());
+        phonemes.push_back(nuclei.get(nucleus).front());
+        if (can_begin_prefix(phonemes, 0)) {
+          continuing.push_back(nucleus);
+        }
+      }
+      if (continuing.empty()) {
+        continue;
+      }
+      initial.push_back(onset);
+      weights.push_back(onset_p[onset]);
+      initial_nuclei_at[onset] = initial_nuclei.size();
+      std::vector<double> nucleus_p = nuclei.probabilities(group);
+      std::vector<double> continuing_p;
+      std::vector<uint8_t> nexts;
+      for (std::size_t nucleus : continuing) {
+        continuing_p.push_back(nucleus_p[nucleus - nuclei.group_offset(group)]);
+        nexts.push_back(nucleus_next[nucleus]);
+      }
+      for (bool word_final : {false, true}) {
+        sets.clear();
+        LengthSet& onset_rest = rest[word_final].emplace_back();
+        for (std::size_t nucleus : continuing) {
+          sets.push_back(nucleus_rest[nucleus][onset_prev[onset] * 2 + word_final]);
+          onset_rest |= then(onset_sets[onset][nucleus_next[nucleus]], sets.back());
+        }
+        initial_nuclei.emplace_back(continuing, continuing_p, sets, nexts);
+      }
+    }
+    if (!initial.empty()) {
+      for (bool word_final : {false, true}) {
+        initial_onsets.emplace_back(initial, weights, rest[word_final],
+                                    std::span(no_nexts).first(initial.size()));
+      }
+    }
+  }
+}
+
+template <class T>
+Constrained<T>::Classes::Classes(std::span<const std::size_t> clusters, std::span<const double> p,
+                                 std::span<const LengthSet> sets, std::span<const uint8_t> nexts) {
+  std::vector<std::vector<std::size_t>> members;
+  for (std::size_t i = 0; i < clusters.size(); ++i) {
+    std::size_t k = 0;
+    while (k < this->sets.size() && (this->sets[k] != sets[i] || this->nexts[k] != nexts[i])) {
+      ++k;
+    }
+    if (k == this->sets.size()) {
+      this->sets.push_back(sets[i]);
+      this->nexts.push_back(nexts[i]);
+      members.emplace_back();
+    }
+    members[k].push_back(i);
+  }
+  std::vector<double> weights;
+  for (const auto& m : members) {
+    weights.clear();
+    for (std::size_t i : m) {
+      this->clusters.push_back(clusters[i]);
+      weights.push_back(p[i]);
+    }
+    this->p.push_back(std::accumulate(weights.begin(), weights.end(), 0.0));
+    offsets.push_back(this->clusters.size());
+    class_of.resize(this->clusters.size(), this->p.size() - 1);
+    samplers.add(weights);
+  }
+  weights.clear();
+  for (const auto& m : members) {
+    for (std::size_t i : m) {
+      weights.push_back(p[i]);
+    }
+  }
+  samplers.add(weights);
+}
+
+template <class T>
+std::size_t Constrained<T>::Classes::draw(std::span<const LengthSet> allowed, Rng& rng) const {
+  // Drawing from all the clusters until one fits keeps to their distribution, and mostly one
+  // does right away
+  const AliasTables tables = samplers.view();
+  for (int i = 0; i < kDraws; ++i) {
+    const std::size_t at = tables.sample(clusters.size(), clusters.size(), rng);
+    const std::size_t k = class_of[at];
+    if ((sets[k] & allowed[nexts[k]]).any()) {
+      return clusters[at];
+    }
+  }
+  double total = 0;
+  for (std::size_t k = 0; k < sets.size(); ++k) {
+    total += (sets[k] & allowed[nexts[k]]).any() ? p[k] : 0;
+  }
+  if (!(total > 0)) {
+    return kNone;
+  }
+  double x = uniform_real(rng) * total;
+  std::size_t chosen = kNone;
+  for (std::size_t k = 0; k < sets.size(); ++k) {
+    if (p[k] > 0 && (sets[k] & allowed[nexts[k]]).any()) {
+      chosen = k;
+      if ((x -= p[k]) < 0) {
+        break;
+      }
+    }
+  }
+  const std::size_t first = offsets[chosen];
+  return clusters[first + tables.sample(first, offsets[chosen + 1] - first, rng)];
+}
+
+template <class T>
+typename Constrained<T>::Classes Constrained<T>::classify(const ClusterTable& table,
+                                                         std::size_t group,
+                                                         std::span<const LengthSet> sets,
+                                                         std::span<const uint8_t> nexts) const {
+  const bool whole = group == table.num_groups();
+  const std::size_t first = whole ? 0 : table.group_offset(group);
+  std::vector<std::size_t> clusters(whole ? table.num_clusters() : table.group_size(group));
+  std::iota(clusters.begin(), clusters.end(), first);
+  return Classes(clusters, whole ? table.probabilities() : table.probabilities(group),
+                 sets.subspan(first, clusters.size()), nexts.subspan(first, clusters.size()));
+}
+
+template <class T>
+typename Constrained<T>::LengthSet Constrained<T>::syllable_allowed(std::size_t used,
+                                                                    std::size_t remaining) const {
+  const LengthSet& ends = can_end[std::min(remaining, can_end.size() - 1)];
+  if (used >= threshold) {
+    return ends[threshold] ? ~LengthSet() : LengthSet();
+  }
+  LengthSet allowed = ends >> used;
+  if (ends[threshold]) {
+    allowed |= ~LengthSet() << (threshold - used);
+  }
+  return allowed;
+}
+
+template <class T>
+bool Constrained<T>::can_begin_prefix(std::span<const uint8_t> phonemes, std::size_t at) const {
+  const std::string& prefix = constraints.prefix;
+  if (phonemes.empty() || at >= prefix.size()) {
+    return true;
+  }
+  const SpellingTable& spellings = system.spelling_table;
+  for (std::size_t j = 0; j < spellings.num_spellings(phonemes.front()); ++j) {
+    std::string_view s = spellings.spelling(phonemes.front(), j);
+    bool matches = true;
+    for (std::size_t i = 0; i < s.size() && matches; ++i) {
+      matches = alphabet[static_cast<unsigned char>(s[i])] &&
+                (at + i >= prefix.size() || s[i] == prefix[at + i]);
+    }
+    if (matches && can_begin_prefix(phonemes.subspan(1), at + s.size())) {
+      return true;
+    }
+  }
+  return false;
+}
+
+template <class T>
+std::vector<Lengths> Constrained<T>::cluster_lengths(const ClusterTable& table) const {
+  std::vector<Lengths> lengths;
+  for (std::size_t cluster = 0; cluster < table.num_clusters(); ++cluster) {
+    Lengths l = {0, 0};
+    for (uint8_t p : table.get(cluster)) {
+      l = l + phoneme_lengths[p];
+    }
+    lengths.push_back(l);
+  }
+  return lengths;
+}
+
+template <class T>
+bool Constrained<T>::get_word(Rng& rng, int max_num_syllables, std::string& out) const {
+  const std::size_t start = out.size();
+  Draft draft = {&constraints, &alphabet, start};
+  if (!constraints.prefix.empty() && initial_onsets.empty()) {
+    return false;
+  }
+  // The number of syllables is drawn uniformly, as get_word draws it, among those that can make
+  // a word of an acceptable length. Past the last entry of can_end, all of them can or none can.
+  const std::size_t last = can_end.size() - 1;
+  const std::size_t max_syllables = max_num_syllables;
+  std::size_t num_counts = 0;
+  for (std::size_t k = 1; k <= std::min(max_syllables, last); ++k) {
+    num_counts += can_end[k][0];
+  }
+  if (max_syllables > last && can_end[last][0]) {
+    num_counts += max_syllables - last;
+  }
+  if (!num_counts) {
+    return false;
+  }
+  for (int attempt = 0; attempt < kMaxAttempts; ++attempt) {
+    out.resize(start);
+    std::size_t num_syllables = 1;
+    for (std::size_t n = uniform(rng, num_counts);
+         !can_end[std::min(num_syllables, last)][0] || n--;) {
+      ++num_syllables;
+    }
+    bool complete = true;
+    for (std::size_t i = 0; complete && i < num_syllables; ++i) {
+      const std::size_t remaining = num_syllables - 1 - i;
+      complete = get_syllable(remaining == 0,
+                              syllable_allowed(out.size() - start, remaining),
+                              syllable_lengths * remaining, rng, out, draft);
+    }
+    if (complete && accepts(std::string_view(out).substr(start))) {
+      return true;
+    }
+  }
+  out.resize(start);
+  return false;
+}
+
+template <class T>
+bool Constrained<T>::get_syllable(bool word_final, const LengthSet& allowed, Lengths after,
+                                  Rng& rng, std::string& out, Draft& draft) const {
+  const System<T>& s = system;
+  const std::size_t syllable_start = out.size();
+  const std::size_t used = syllable_start - draft.start;
+  for (int attempt = 0; attempt < kSyllableAttempts; ++attempt) {
+    // Drawn as get_onset, get_nucleus and get_coda do, but only among the clusters after which
+    // the rest of the syllable can still take an allowed number of letters
+    const bool initial = used == 0 && !constraints.prefix.empty();
+    const std::size_t onset =
+        (initial ? initial_onsets : onsets)[word_final].draw({&allowed, 1}, rng);
+    if (onset == kNone) {
+      return false;
+    }
+    Syllable syllable;
+    syllable.onset = s.get_cluster(s.onset_table, onset);
+    // What the rest of the syllable can take after the onset, by the NextClass of the nucleus
+    std::array<LengthSet, Context::kNumNext> after_onset;
+    for (std::size_t next = 0; next < Context::kNumNext; ++next) {
+      after_onset[next] = left_after(allowed, onset_sets[onset][next], onset_lengths[onset]);
+    }
+
+    const std::size_t group = s.nucleus_group[s.index_of(syllable.onset.back())];
+    const std::size_t prev = onset_prev[onset];
+    const Classes& nucleus_classes = initial
+                                         ? initial_nuclei[initial_nuclei_at[onset] + word_final]
+                                         : nuclei[in_context(group, prev, word_final)];
+    const std::size_t nucleus = nucleus_classes.draw(after_onset, rng);
+    if (nucleus == kNone) {
+      return false;
+    }
+    syllable.nucleus = s.get_cluster(s.nucleus_table, nucleus).front();
+    // And after the nucleus, by the NextClass of the coda or the end of the syllable
+    std::array<LengthSet, Context::kNumNext> after_nucleus;
+    for (std::size_t next = 0; next < Context::kNumNext; ++next) {
+      const LengthSet& set = nucleus_sets[nucleus][prev * Context::kNumNext + next];
+      after_nucleus[next] =
+          left_after(after_onset[nucleus_next[nucleus]], set, nucleus_lengths[nucleus]);
+    }
+
+    // Without a coda half the time, as sample_coda, when both ways can still fit
+    const std::size_t n = s.index_of(syllable.nucleus);
+    const NextClass end = word_final ? NextClass::WORD_END : NextClass::SYLLABLE_END;
+    const bool open =
+        !s.nuclei_requiring_coda[n] && after_nucleus[static_cast<std::size_t>(end)][0];
+    if (!open || !uniform(rng, 2)) {
+      const std::size_t coda_group =
+          s.coda_group[n] == System<T>::kAnyGroup ? s.coda_table.num_groups() : s.coda_group[n];
+      const std::size_t coda =
+          codas[in_context(coda_group, nucleus_prev[nucleus], word_final)].draw(after_nucleus, rng);
+      if (coda != kNone) {
+        syllable.coda = s.get_cluster(s.coda_table, coda);
+      } else if (!open) {
+        return false;
+      }
+    }
+
+    // The letters that can follow each phoneme, accumulated from the end of the word
+    InplaceVector<const Phoneme*, 2 * kMaxClusterSize + 1> phonemes;
+    for (const Phoneme* p : syllable.onset) {
+      phonemes.push_back(p);
+    }
+    phonemes.push_back(syllable.nucleus);
+    for (const Phoneme* p : syllable.coda) {
+      phonemes.push_back(p);
+    }
+    draft.rest.clear();
+    for (std::size_t i = 0; i < phonemes.size(); ++i) {
+      draft.rest.push_back({});
+    }
+    Lengths rest = after;
+    for (std::size_t i = phonemes.size(); i-- > 0;) {
+      draft.rest[i] = rest;
+      rest = rest + phoneme_lengths[s.index_of(phonemes[i])];
+    }
+    draft.position = 0;
+    draft.failed = false;
+    s.get_spelling(syllable, word_final, rng, out, &draft);
+    if (!draft.failed) {
+      return true;
+    }
+    out.resize(syllable_start);
+  }
+  return false;
+}
+
+}  // namespace phonology
@@ -0,0 +1,198 @@
+#include "image.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string_view>
+#include <utility>
+
+#include "output.hpp"
+
+namespace phonology {
+
+// Private functions
+
+namespace {
+
+// Whether bytes start with a header that describes them
+bool valid_header(std::span<const std::byte> bytes) {
+  return !bytes.empty() && Image::next(bytes).size() == bytes.size();
+}
+
+Image::Header make_header(uint64_t size, uint64_t num_arrays) {
+  Image::Header header = {};
+  std::memcpy(header.magic, Image::kMagic, sizeof(header.magic));
+  header.version = Image::kVersion;
+  header.byte_order = Image::kByteOrder;
+  header.size = size;
+  header.num_arrays = num_arrays;
+  return header;
+}
+
+std::size_t padded(std::size_t size) { return (size + 7) & ~std::size_t{7}; }
+
+}  // namespace
+
+// Public functions
+
+Image::Image(std::vector<uint64_t>&& image_words) : words(std::move(image_words)) {
+  data = reinterpret_cast<const std::byte*>(words.data());
+  size = words.size() * sizeof(uint64_t);
+}
+
+Image Image::map_file(const char* path) {
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) < 0) {
+    std::fprintf(stderr, "image: cannot open %s: %s\n", path, std::strerror(errno));
+    std::abort();
+  }
+  Image image;
+  image.size = st.st_size;
+  // An empty file, which only a stream of no images may be, cannot be mapped
+  if (image.size) {
+    image.mapping = mmap(nullptr, image.size, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  close(fd);
+  if (image.mapping == MAP_FAILED) {
+    std::fprintf(stderr, "image: cannot map %s: %s\n", path, std::strerror(errno));
+    std::abort();
+  }
+  image.data = static_cast<const std::byte*>(image.mapping);
+  return image;
+}
+
+Image Image::map(const char* path) {
+  Image image(map_file(path));
+  if (!valid_header(image.bytes())) {
+    std::fprintf(stderr, "image: %s is not a version %u phonology image for this machine\n", path,
+                 kVersion);
+    std::abort();
+  }
+  return image;
+}
+
+Image Image::view(std::span<const std::byte> bytes) {
+  if (!valid_header(bytes)) {
+    std::fprintf(stderr, "image: not a version %u phonology image for this machine\n", kVersion);
+    std::abort();
+  }
+  Image image;
+  image.data = bytes.data();
+  image.size = bytes.size();
+  return image;
+}
+
+Image Image::map_stream(const char* path) {
+  Image image(map_file(path));
+  for (std::span<const std::byte> rest = image.bytes(); !rest.empty();) {
+    std::size_t size = next(rest).size();
+    if (!size) {
+      std::fprintf(stderr, "image: %s is not a stream of version %u phonology images for this "
+                   "machine\n", path, kVersion);
+      std::abort();
+    }
+    rest = rest.subspan(size);
+  }
+  return image;
+}
+
+std::span<const std::byte> Image::next(std::span<const std::byte> bytes) {
+  Header header;
+  if (bytes.size() < sizeof(header)) {
+    return {};
+  }
+  std::memcpy(&header, bytes.data(), sizeof(header));
+  if (std::memcmp(header.magic, kMagic, sizeof(header.magic)) != 0 || header.version != kVersion ||
+      header.byte_order != kByteOrder || header.size < sizeof(header) || header.size % 8 != 0 ||
+      header.size > bytes.size()) {
+    return {};
+  }
+  return bytes.first(header.size);
+}
+
+Image& Image::operator=(Image&& other) {
+  if (this != &other) {
+    unmap();
+    // Moving the vector keeps its buffer, so data stays valid
+    words = std::move(other.words);
+    mapping = std::exchange(other.mapping, nullptr);
+    data = std::exchange(other.data, nullptr);
+    size = std::exchange(other.size, 0);
+  }
+  return *this;
+}
+
+Image::~Image() { unmap(); }
+
+void Image::unmap() {
+  if (mapping) {
+    munmap(mapping, size);
+    mapping = nullptr;
+  }
+}
+
+void Image::save(const char* path) const {
+  OutputWriter out(path);
+  out.write(std::string_view(reinterpret_cast<const char*>(data), size));
+}
+
+ImageWriter::ImageWriter() { bytes.resize(sizeof(Image::Header)); }
+
+void ImageWriter::append(const void* p, std::size_t size) {
+  const auto* first = static_cast<const std::byte*>(p);
+  bytes.insert(bytes.end(), first, first + size);
+  bytes.resize(padded(bytes.size()));
+}
+
+Image ImageWriter::finish() {
+  Image::Header header = make_header(bytes.size(), num_arrays);
+  std::memcpy(bytes.data(), &header, sizeof(header));
+  // Copied into 64-bit words so that every array is aligned, as in a mapped file
+  std::vector<uint64_t> words(bytes.size() / sizeof(uint64_t));
+  std::memcpy(words.data(), bytes.data(), bytes.size());
+  return Image(std::move(words));
+}
+
+void GatherImageWriter::finish(OutputWriter& out) const {
+  static constexpr std::byte kPadding[8] = {};
+  std::size_t size = sizeof(Image::Header);
+  for (const Array& array : arrays) {
+    size += sizeof(array.header) + padded(array.bytes.size());
+  }
+  const Image::Header header = make_header(size, arrays.size());
+  InplaceVector<iovec, OutputWriter::kMaxBlocks> iov;
+  // writev does not write through its iovecs, whatever their type says
+  auto block = [&](const void* p, std::size_t size) {
+    iov.push_back({const_cast<void*>(p), size});
+  };
+  block(&header, sizeof(header));
+  for (const Array& array : arrays) {
+    block(&array.header, sizeof(array.header));
+    block(array.bytes.data(), array.bytes.size());
+    block(kPadding, padded(array.bytes.size()) - array.bytes.size());
+  }
+  out.write(std::span<const iovec>(iov.data(), iov.size()));
+}
+
+ImageReader::ImageReader(std::span<const std::byte> bytes) {
+  if (!valid_header(bytes)) {
+    failed = true;
+    next = nullptr;
+    remaining = 0;
+    return;
+  }
+  Image::Header header;
+  std::memcpy(&header, bytes.data(), sizeof(header));
+  num_arrays = header.num_arrays;
+  next = bytes.data() + sizeof(header);
+  remaining = bytes.size() - sizeof(header);
+}
+
+}  // namespace phonology
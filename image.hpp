@@ -0,0 +1,176 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "inplace_vector.hpp"
+#include "output.hpp"
+
+namespace phonology {
+
+// The packed tables of a System, laid out so that they are used in place: a header, then arrays
+// read back in the order they were written, each an ArrayHeader followed by its elements and
+// padded to 8 bytes. Loading a file is a read-only mmap, and the tables are views of the mapping,
+// so nothing is parsed or allocated per entry. Images are in the byte order of the machine that
+// wrote them; any change to what is written must bump kVersion.
+class Image {
+ public:
+  static constexpr char kMagic[8] = {'P', 'H', 'O', 'N', 'O', 'L', 'O', 'G'};
+  static constexpr uint32_t kVersion = 2;
+  static constexpr uint32_t kByteOrder = 0x01020304;
+
+  struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t size;
+    uint64_t num_arrays;
+  };
+  struct ArrayHeader {
+    uint64_t element_size;
+    uint64_t count;
+  };
+
+  Image() = default;
+  // Takes over an image built in memory
+  explicit Image(std::vector<uint64_t>&& words);
+  // Maps the image file at path. Aborts if it cannot be read or is not an image of this version.
+  static Image map(const char* path);
+  // Views an image in memory that outlives it, such as one linked into read-only data, in place.
+  // Aborts as map does.
+  static Image view(std::span<const std::byte> bytes);
+  // Maps a file of images written one after another, such as a record stream, which next then
+  // splits up. Aborts as map does unless the images make up the whole file.
+  static Image map_stream(const char* path);
+  // The image at the start of bytes, or an empty span if bytes do not start with one, as when
+  // they are empty
+  static std::span<const std::byte> next(std::span<const std::byte> bytes);
+  Image(Image&& other) { *this = std::move(other); }
+  Image& operator=(Image&& other);
+  Image(const Image&) = delete;
+  Image& operator=(const Image&) = delete;
+  ~Image();
+
+  std::span<const std::byte> bytes() const { return {data, size}; }
+  // Writes the image to a file, creating or truncating it
+  void save(const char* path) const;
+
+ private:
+  // Maps the file at path read-only, or aborts
+  static Image map_file(const char* path);
+  void unmap();
+
+  std::vector<uint64_t> words;
+  void* mapping = nullptr;
+  const std::byte* data = nullptr;
+  std::size_t size = 0;
+};
+
+// Writes the arrays of an image in order
+class ImageWriter {
+ public:
+  ImageWriter();
+
+  template <class T>
+  void write(std::span<const T> array) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    Image::ArrayHeader header = {sizeof(T), array.size()};
+    append(&header, sizeof(header));
+    append(array.data(), array.size_bytes());
+    ++num_arrays;
+  }
+  template <class T>
+  void write(const std::vector<T>& array) {
+    write(std::span<const T>(array));
+  }
+
+  Image finish();
+
+ private:
+  // Appends size bytes, then zeros up to the next multiple of 8
+  void append(const void* p, std::size_t size);
+
+  std::vector<std::byte> bytes;
+  uint64_t num_arrays = 0;
+};
+
+// Writes an image straight from the arrays it is made of, which must stay alive until finish
+// returns. Unlike ImageWriter, nothing is copied: the arrays go out in place, between their
+// headers and padding, in a single writev(2).
+class GatherImageWriter {
+ public:
+  static constexpr std::size_t kMaxArrays = (OutputWriter::kMaxBlocks - 1) / 3;
+
+  template <class T>
+  void write(std::span<const T> array) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    assert(arrays.size() < kMaxArrays);
+    arrays.push_back({{sizeof(T), array.size()}, std::as_bytes(array)});
+  }
+  template <class T>
+  void write(const std::vector<T>& array) {
+    write(std::span<const T>(array));
+  }
+
+  // Writes the image to out
+  void finish(OutputWriter& out) const;
+
+ private:
+  struct Array {
+    Image::ArrayHeader header;
+    std::span<const std::byte> bytes;
+  };
+  InplaceVector<Array, kMaxArrays> arrays;
+};
+
+// Reads the arrays of an image back in the order they were written. A read that does not match
+// the image returns an empty array and marks the reader failed, so a loader can read everything
+// and check once at the end.
+class ImageReader {
+ public:
+  explicit ImageReader(const Image& image) : ImageReader(image.bytes()) {}
+  explicit ImageReader(std::span<const std::byte> image);
+
+  template <class T>
+  std::span<const T> read() {
+    Image::ArrayHeader header;
+    if (failed || remaining < sizeof(header)) {
+      failed = true;
+      return {};
+    }
+    std::memcpy(&header, next, sizeof(header));
+    const std::size_t available = remaining - sizeof(header);
+    if (header.element_size != sizeof(T) || header.count > available / sizeof(T)) {
+      failed = true;
+      return {};
+    }
+    const std::size_t padded = (header.count * sizeof(T) + 7) & ~std::size_t{7};
+    if (padded > available) {
+      failed = true;
+      return {};
+    }
+    std::span<const T> array(reinterpret_cast<const T*>(next + sizeof(header)), header.count);
+    next += sizeof(header) + padded;
+    remaining -= sizeof(header) + padded;
+    ++num_read;
+    return array;
+  }
+
+  // Whether every array read so far was in the image and the whole image has been read
+  bool complete() const { return !failed && !remaining && num_read == num_arrays; }
+
+ private:
+  const std::byte* next;
+  std::size_t remaining;
+  uint64_t num_arrays = 0;
+  uint64_t num_read = 0;
+  bool failed = false;
+};
+
+}  // namespace phonology
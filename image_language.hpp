@@ -0,0 +1,17 @@
+#pragma once
+#include "image.hpp"
+#include "phonology.hpp"
+
+namespace phonology {
+
+// A language loaded from a phonology image saved by another System, with the tables in place in
+// the mapped file. Draws exactly the words the saved system draws.
+class ImageLanguage : public System<ImageLanguage> {
+  friend class System;
+
+ public:
+  explicit ImageLanguage(const char* path) : System(Image::map(path)) {}
+  explicit ImageLanguage(Image&& image) : System(std::move(image)) {}
+};
+
+}  // namespace phonology
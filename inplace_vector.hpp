@@ -0,0 +1,81 @@
+#pragma once
+
+#include <version>
+
+#ifdef __cpp_lib_inplace_vector
+#include <inplace_vector>
+#else
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <initializer_list>
+#include <utility>
+#endif
+
+namespace phonology {
+
+#ifdef __cpp_lib_inplace_vector
+
+template <class T, std::size_t N>
+using InplaceVector = std::inplace_vector<T, N>;
+
+#else
+
+// Stand-in for std::inplace_vector until the standard library ships it. Only the subset the
+// phonology code needs, and only for trivially copyable element types.
+template <class T, std::size_t N>
+class InplaceVector {
+ public:
+  using value_type = T;
+  using size_type = std::size_t;
+  using reference = T&;
+  using const_reference = const T&;
+  using iterator = T*;
+  using const_iterator = const T*;
+
+  constexpr InplaceVector() = default;
+  constexpr InplaceVector(std::initializer_list<T> init) {
+    for (const auto& e : init) {
+      push_back(e);
+    }
+  }
+
+  constexpr iterator begin() { return elements.data(); }
+  constexpr const_iterator begin() const { return elements.data(); }
+  constexpr iterator end() { return elements.data() + count; }
+  constexpr const_iterator end() const { return elements.data() + count; }
+
+  constexpr T* data() { return elements.data(); }
+  constexpr const T* data() const { return elements.data(); }
+  constexpr size_type size() const { return count; }
+  constexpr bool empty() const { return count == 0; }
+  static constexpr size_type capacity() { return N; }
+
+  constexpr reference operator[](size_type i) { return elements[i]; }
+  constexpr const_reference operator[](size_type i) const { return elements[i]; }
+  constexpr reference front() { return elements[0]; }
+  constexpr const_reference front() const { return elements[0]; }
+  constexpr reference back() { return elements[count - 1]; }
+  constexpr const_reference back() const { return elements[count - 1]; }
+
+  constexpr void push_back(const T& value) {
+    assert(count < N);
+    elements[count++] = value;
+  }
+  template <class... Args>
+  constexpr reference emplace_back(Args&&... args) {
+    assert(count < N);
+    elements[count] = T(std::forward<Args>(args)...);
+    return elements[count++];
+  }
+  constexpr void pop_back() { --count; }
+  constexpr void clear() { count = 0; }
+
+ private:
+  std::array<T, N> elements{};
+  size_type count = 0;
+};
+
+#endif
+
+}  // namespace phonology
@@ -0,0 +1,26 @@
+#include "language.hpp"
+
+namespace phonology {
+
+// Public functions
+
+std::unique_ptr<Language> Language::make(std::string_view tag) {
+  std::unique_ptr<Language> language;
+  if (tag == "en-US") {
+    language = std::make_unique<LanguageOf<AmericanEnglish>>();
+  } else if (tag == "fr-FR") {
+    language = std::make_unique<LanguageOf<MetropolitanFrench>>();
+  } else {
+    return nullptr;
+  }
+  language->name = tag;
+  return language;
+}
+
+std::unique_ptr<Language> Language::load(const char* path) {
+  std::unique_ptr<Language> language = std::make_unique<LanguageOf<ImageLanguage>>(path);
+  language->name = path;
+  return language;
+}
+
+}  // namespace phonology
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "american_english.hpp"
+#include "image_language.hpp"
+#include "metropolitan_french.hpp"
+#include "phonology.hpp"
+#include "random.hpp"
+
+namespace phonology {
+
+// A language picked at runtime, by tag or from an image. Calls through a Language are virtual, so
+// they are meant to be made once per batch of words: generate_batch enters the templated
+// generate_batch of the concrete System, and visit hands the System itself to a generic callable,
+// so that every word below either is drawn exactly as if the language had been named in the code.
+class Language {
+ public:
+  // Tags of the built-in languages
+  static constexpr std::string_view kTags[] = {"en-US", "fr-FR"};
+
+  // The built-in language with the given tag, or nullptr if there is none
+  static std::unique_ptr<Language> make(std::string_view tag);
+  // The language saved in the image at path. Aborts if it cannot be loaded.
+  static std::unique_ptr<Language> load(const char* path);
+
+  Language(const Language&) = delete;
+  Language& operator=(const Language&) = delete;
+  virtual ~Language() = default;
+
+  // The tag the language was made with, or the path of its image
+  std::string_view tag() const { return name; }
+
+  virtual void generate_batch(Rng& rng, std::size_t n, int max_num_syllables,
+                              WordBatch& out) const = 0;
+  virtual void save(const char* path) const = 0;
+
+  // Returns f(system) for the concrete System behind the language. f is instantiated for every
+  // kind of System, and must return the same type for all of them.
+  template <class F>
+  auto visit(F&& f) const {
+    return visit<0>(std::forward<F>(f));
+  }
+
+ protected:
+  // Every kind of System a Language can hold, indexed by kind
+  using Systems = std::tuple<AmericanEnglish, MetropolitanFrench, ImageLanguage>;
+  template <class T, std::size_t I = 0>
+  static constexpr std::size_t kind_of() {
+    if constexpr (std::is_same_v<T, std::tuple_element_t<I, Systems>>) {
+      return I;
+    } else {
+      return kind_of<T, I + 1>();
+    }
+  }
+
+  explicit Language(std::size_t kind) : kind(kind) {}
+
+ private:
+  template <std::size_t I, class F>
+  auto visit(F&& f) const;
+
+  std::size_t kind;
+  std::string name;
+};
+
+template <class T>
+class LanguageOf final : public Language {
+ public:
+  template <class... Args>
+  explicit LanguageOf(Args&&... args)
+      : Language(kind_of<T>()), system(std::forward<Args>(args)...) {}
+
+  void generate_batch(Rng& rng, std::size_t n, int max_num_syllables,
+                      WordBatch& out) const override {
+    phonology::generate_batch(system, rng, n, max_num_syllables, out);
+  }
+  void save(const char* path) const override { system.save(path); }
+
+  const T system;
+};
+
+template <std::size_t I, class F>
+auto Language::visit(F&& f) const {
+  using T = std::tuple_element_t<I, Systems>;
+  if constexpr (I + 1 < std::tuple_size_v<Systems>) {
+    if (kind != I) {
+      return visit<I + 1>(std::forward<F>(f));
+    }
+  }
+  return f(static_cast<const LanguageOf<T>*>(this)->system);
+}
+
+}  // namespace phonology
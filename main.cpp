@@ -1,25 +1,654 @@
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cinttypes>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
 #include <cstdlib>
-#include <cstring>
 #include <ctime>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
 #include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
 
-#include "metropolitan_french.hpp"
+#include "constraints.hpp"
+#include "language.hpp"
+#include "mixer.hpp"
+#include "output.hpp"
 #include "phonology.hpp"
+#include "random.hpp"
+#include "records.hpp"
+#include "unique_set.hpp"
+#include "vocabulary.hpp"
 
-int main(int argc, char* argv[]) {
-  int num_words = 100;
-  if (argc >= 2) {
-    num_words = std::stoi(argv[1]);
+namespace {
+
+constexpr uint64_t kWordsPerChunk = 1 << 16;
+
+// Parses all of text as a decimal number, or returns false
+template <class T>
+bool parse_number(std::string_view text, T& value) {
+  const char* end = text.data() + text.size();
+  auto [last, error] = std::from_chars(text.data(), end, value);
+  return !text.empty() && error == std::errc() && last == end;
+}
+
+// What to generate, shared by every worker. Word n of the whole stream is drawn from
+// counter_rng(seed, n), so the output for a range of n does not depend on how it is split up.
+struct Job {
+  uint64_t seed;
+  uint64_t first;
+  uint64_t num_words;
+  int max_num_syllables;
+  char delimiter;
+  phonology::Transcription transcription = phonology::Transcription::NONE;
+  // Whether each word is preceded by the tag of its language and a tab
+  bool tagged = false;
+  // Only set in --unique mode
+  phonology::UniqueSet* unique = nullptr;
+  std::atomic<bool> exhausted = false;
+  // Set along with exhausted when the length, prefix, suffix and alphabet constraints could not be
+  // met
+  std::atomic<bool> unsatisfiable = false;
+};
+
+// Draws a word into out, either freely, from a mix of languages or under constraints. Returns
+// false if the constraints could not be met.
+template <class T>
+bool draw_word(const phonology::System<T>& system, phonology::Rng& rng, const Job& job,
+               std::string& out) {
+  phonology::get_word(system, rng, job.max_num_syllables, out, job.transcription);
+  return true;
+}
+
+bool draw_word(const phonology::Mixer& mixer, phonology::Rng& rng, const Job& job,
+               std::string& out) {
+  mixer.get_word(rng, job.max_num_syllables, out, job.transcription);
+  return true;
+}
+
+template <class T>
+bool draw_word(const phonology::Constrained<T>& constrained, phonology::Rng& rng, const Job& job,
+               std::string& out) {
+  return constrained.get_word(rng, job.max_num_syllables, out);
+}
+
+// Watches how often --unique attempts produce a new word. Once a whole window of attempts yields
+// almost nothing, the vocabulary is treated as used up rather than spinning on it forever.
+class Novelty {
+ public:
+  // Returns true once the vocabulary looks exhausted
+  bool record(bool fresh) {
+    ++attempts;
+    fresh_words += fresh;
+    if (attempts < kWindow) {
+      return false;
+    }
+    bool exhausted = fresh_words < kMinFresh;
+    attempts = 0;
+    fresh_words = 0;
+    return exhausted;
+  }
+
+ private:
+  static constexpr uint64_t kWindow = 1 << 16;
+  static constexpr uint64_t kMinFresh = 16;
+  uint64_t attempts = 0;
+  uint64_t fresh_words = 0;
+};
+
+// Appends word n and its delimiter to out, drawing again while --unique rejects the word as seen.
+// Returns false, leaving out untouched, once the vocabulary is exhausted.
+template <class T>
+bool append_word(const T& system, uint64_t n, Job& job, Novelty& novelty, std::string& out) {
+  phonology::Rng rng = phonology::counter_rng(job.seed, n);
+  while (!job.exhausted.load(std::memory_order_relaxed)) {
+    std::size_t start = out.size();
+    if (!draw_word(system, rng, job, out)) {
+      job.unsatisfiable.store(true, std::memory_order_relaxed);
+      job.exhausted.store(true, std::memory_order_relaxed);
+      break;
+    }
+    // Words are told apart by their spelling alone, not the tag or transcription around it
+    std::string_view word = std::string_view(out).substr(start);
+    if (job.tagged) {
+      word.remove_prefix(word.find('\t') + 1);
+    }
+    bool fresh = !job.unique || job.unique->insert(word.substr(0, word.find('\t')));
+    if (job.unique && novelty.record(fresh)) {
+      job.exhausted.store(true, std::memory_order_relaxed);
+    }
+    if (fresh) {
+      out += job.delimiter;
+      return true;
+    }
+    out.resize(start);
+  }
+  return false;
+}
+
+// Generates chunks worker, worker + n, worker + 2n, ... into two alternating buffers, so that the
+// writer can drain one while the next is being filled
+struct Worker {
+  std::string buffers[2];
+  bool ready[2] = {false, false};
+  // Set when the worker has stopped, whether or not it got through all its chunks
+  bool done = false;
+  std::mutex mutex;
+  std::condition_variable cv;
+};
+
+template <class T>
+void generate_chunks(const T& system, Worker& worker, uint64_t first, uint64_t stride, Job& job) {
+  Novelty novelty;
+  for (uint64_t chunk = first, k = 0; chunk * kWordsPerChunk < job.num_words;
+       chunk += stride, ++k) {
+    std::string& buffer = worker.buffers[k % 2];
+    {
+      std::unique_lock lock(worker.mutex);
+      worker.cv.wait(lock, [&] { return !worker.ready[k % 2] || job.exhausted; });
+      if (worker.ready[k % 2]) {
+        break;
+      }
+    }
+    buffer.clear();
+    uint64_t end = std::min(job.num_words, (chunk + 1) * kWordsPerChunk);
+    for (uint64_t i = chunk * kWordsPerChunk; i < end; ++i) {
+      if (!append_word(system, job.first + i, job, novelty, buffer)) {
+        break;
+      }
+    }
+    {
+      std::lock_guard lock(worker.mutex);
+      worker.ready[k % 2] = true;
+    }
+    worker.cv.notify_all();
+    if (job.exhausted) {
+      break;
+    }
+  }
+  {
+    std::lock_guard lock(worker.mutex);
+    worker.done = true;
+  }
+  worker.cv.notify_all();
+}
+
+// Chunks are generated round-robin by the threads and written in order, so the output is the same
+// for any number of threads, apart from which duplicates --unique rejects. The system is only
+// ever read after construction, so all threads share one instance. If the vocabulary runs out in
+// --unique mode, every worker hands over what it has and the output stops at the first chunk that
+// never got started.
+template <class T>
+void generate_bulk(const T& system, int num_threads, Job& job, phonology::OutputWriter& out) {
+  std::vector<Worker> workers(num_threads);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < num_threads; ++t) {
+    threads.emplace_back(generate_chunks<T>, std::cref(system), std::ref(workers[t]), t,
+                         num_threads, std::ref(job));
+  }
+  for (uint64_t chunk = 0; chunk * kWordsPerChunk < job.num_words; ++chunk) {
+    Worker& worker = workers[chunk % num_threads];
+    uint64_t k = chunk / num_threads;
+    {
+      std::unique_lock lock(worker.mutex);
+      worker.cv.wait(lock, [&] { return worker.ready[k % 2] || worker.done; });
+      if (!worker.ready[k % 2]) {
+        break;
+      }
+    }
+    const std::string& buffer = worker.buffers[k % 2];
+    out.write(buffer);
+    {
+      std::lock_guard lock(worker.mutex);
+      worker.ready[k % 2] = false;
+    }
+    worker.cv.notify_all();
+  }
+  // Wake any worker still waiting for a buffer the writer will no longer drain
+  for (auto& worker : workers) {
+    std::lock_guard lock(worker.mutex);
+    worker.cv.notify_all();
+  }
+  for (auto& thread : threads) {
+    thread.join();
   }
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  uint64_t num_words = 100;
   int max_num_syllables = 1;
-  if (argc == 3) {
-    max_num_syllables = std::stoi(argv[2]);
+  int num_threads = 0;
+  char delimiter = '\n';
+  const char* output_path = nullptr;
+  int output_fd = -1;
+  bool unique = false;
+  uint64_t seed = time(nullptr);
+  uint64_t start = 0;
+  std::optional<uint64_t> count;
+  uint64_t shard = 0;
+  uint64_t num_shards = 1;
+  bool vocabulary_size = false;
+  bool enumerate = false;
+  bool shuffle = false;
+  std::optional<std::string_view> tag;
+  const char* image_path = nullptr;
+  std::string_view mix_spec;
+  bool tag_language = false;
+  phonology::Transcription transcription = phonology::Transcription::NONE;
+  bool records = false;
+  const char* read_records_path = nullptr;
+  const char* write_image_path = nullptr;
+  const char* counts_path = nullptr;
+  const char* write_counts_path = nullptr;
+  phonology::Constraints constraints;
+  std::vector<std::string_view> positional;
+  for (int i = 1; i < argc; ++i) {
+    std::string_view arg = argv[i];
+    // Option values are read by text and number, which fail if the value is missing or, for a
+    // number, is not one
+    const char* given = nullptr;
+    auto text = [&](auto& out) {
+      if (i + 1 == argc) {
+        return false;
+      }
+      given = argv[++i];
+      out = given;
+      return true;
+    };
+    auto number = [&](auto& out) {
+      if (i + 1 == argc) {
+        return false;
+      }
+      given = argv[++i];
+      return parse_number(given, out);
+    };
+    bool valid = true;
+    if (arg == "--threads") {
+      valid = number(num_threads);
+    } else if (arg == "--unique") {
+      unique = true;
+    } else if (arg == "--seed") {
+      valid = number(seed);
+    } else if (arg == "--start") {
+      valid = number(start);
+    } else if (arg == "--count") {
+      valid = number(count.emplace());
+    } else if (arg == "--shard") {
+      valid = text(given) && std::sscanf(given, "%" SCNu64 "/%" SCNu64, &shard, &num_shards) == 2 &&
+              shard < num_shards;
+      if (!valid && given) {
+        std::cerr << "generator: --shard takes i/M with i < M, not " << given << "\n";
+        return 1;
+      }
+    } else if (arg == "--vocabulary-size") {
+      vocabulary_size = true;
+    } else if (arg == "--enumerate") {
+      enumerate = true;
+    } else if (arg == "--shuffle") {
+      shuffle = true;
+    } else if (arg == "--min-length") {
+      valid = number(constraints.min_length);
+    } else if (arg == "--max-length") {
+      valid = number(constraints.max_length);
+    } else if (arg == "--prefix") {
+      valid = text(constraints.prefix);
+    } else if (arg == "--suffix") {
+      valid = text(constraints.suffix);
+    } else if (arg == "--alphabet") {
+      valid = text(constraints.alphabet);
+    } else if (arg == "--lang") {
+      valid = text(tag);
+    } else if (arg == "--mix") {
+      valid = text(mix_spec);
+    } else if (arg == "--tag") {
+      tag_language = true;
+    } else if (arg == "--ipa") {
+      transcription = phonology::Transcription::IPA;
+    } else if (arg == "--ipa-syllables") {
+      transcription = phonology::Transcription::IPA_SYLLABLES;
+    } else if (arg == "--records") {
+      records = true;
+    } else if (arg == "--read-records") {
+      valid = text(read_records_path);
+    } else if (arg == "--image") {
+      valid = text(image_path);
+    } else if (arg == "--write-image") {
+      valid = text(write_image_path);
+    } else if (arg == "--counts") {
+      valid = text(counts_path);
+    } else if (arg == "--write-counts") {
+      valid = text(write_counts_path);
+    } else if (arg == "--null") {
+      delimiter = '\0';
+    } else if (arg == "--output") {
+      valid = text(output_path);
+    } else if (arg == "--fd") {
+      valid = number(output_fd);
+    } else if (arg.starts_with("--")) {
+      std::cerr << "generator: unknown option " << arg << "\n";
+      return 1;
+    } else {
+      positional.push_back(arg);
+    }
+    if (!valid) {
+      if (given) {
+        std::cerr << "generator: " << arg << " does not take " << given << "\n";
+      } else {
+        std::cerr << "generator: " << arg << " needs a value\n";
+      }
+      return 1;
+    }
+  }
+  // Positional arguments are the number of words and the maximum number of syllables per word
+  if (positional.size() > 2 ||
+      (positional.size() >= 1 && !parse_number(positional[0], num_words)) ||
+      (positional.size() >= 2 &&
+       (!parse_number(positional[1], max_num_syllables) || max_num_syllables < 1))) {
+    std::cerr << "generator: expected a number of words and a number of syllables of at least 1, "
+                 "not";
+    for (std::string_view arg : positional) {
+      std::cerr << " " << arg;
+    }
+    std::cerr << "\n";
+    return 1;
+  }
+  if (count) {
+    num_words = *count;
+  }
+  if (num_words > UINT64_MAX - start) {
+    std::cerr << "generator: --start plus --count must be at most " << UINT64_MAX << "\n";
+    return 1;
+  }
+  // Shard i of M takes the i-th of M nearly equal consecutive slices of the requested range, so
+  // concatenating the shards in order gives the unsharded output
+  uint64_t first = start + static_cast<__uint128_t>(num_words) * shard / num_shards;
+  num_words = start + static_cast<__uint128_t>(num_words) * (shard + 1) / num_shards - first;
+  auto unknown_language = [](std::string_view name) {
+    std::cerr << "generator: unknown language " << name << ", expected one of";
+    for (std::string_view known : phonology::Language::kTags) {
+      std::cerr << " " << known;
+    }
+    std::cerr << "\n";
+    return 1;
+  };
+  bool constrained = constraints.min_length > 0 || constraints.max_length != SIZE_MAX ||
+                     !constraints.prefix.empty() || !constraints.suffix.empty() ||
+                     !constraints.alphabet.empty();
+  // --mix takes TAG[:WEIGHT],... with weights of 1 unless given
+  std::vector<phonology::Mixer::Component> mix;
+  for (std::string_view rest = mix_spec; !rest.empty();) {
+    std::string_view item = rest.substr(0, rest.find(','));
+    rest.remove_prefix(std::min(rest.size(), item.size() + 1));
+    std::string_view name = item.substr(0, item.find(':'));
+    double weight = 1;
+    if (name.size() < item.size()) {
+      weight = std::strtod(std::string(item.substr(name.size() + 1)).c_str(), nullptr);
+    }
+    auto language = phonology::Language::make(name);
+    if (!language) {
+      return unknown_language(name);
+    }
+    if (!(weight > 0)) {
+      std::cerr << "generator: --mix weights must be positive, not " << item << "\n";
+      return 1;
+    }
+    mix.push_back({std::move(language), weight});
+  }
+  if (!mix.empty() && (vocabulary_size || enumerate || shuffle || constrained || tag ||
+                       image_path || write_image_path || counts_path || write_counts_path)) {
+    std::cerr << "generator: --mix only samples words, without constraints, --lang or images\n";
+    return 1;
+  }
+  if (tag_language && mix.empty()) {
+    std::cerr << "generator: --tag only applies to --mix, which draws from several languages\n";
+    return 1;
+  }
+  // Either names the one language, so giving both would leave one of them unused
+  if (tag && image_path) {
+    std::cerr << "generator: --lang and --image both pick the language, give only one\n";
+    return 1;
+  }
+  if (counts_path && !shuffle && !vocabulary_size) {
+    std::cerr << "generator: --counts only applies to --shuffle and --vocabulary-size\n";
+    return 1;
+  }
+  if (write_counts_path && (write_image_path || counts_path || vocabulary_size || enumerate ||
+                            shuffle || records || constrained || unique ||
+                            transcription != phonology::Transcription::NONE)) {
+    std::cerr << "generator: --write-counts only writes the counts of a language and number of "
+                 "syllables\n";
+    return 1;
   }
-  srand(time(nullptr));
-  phonology::MetropolitanFrench mf;
-  for (int i = 0; i < num_words; ++i) {
-    std::cout << phonology::get_word(mf, max_num_syllables) << "\n";
+  if (transcription != phonology::Transcription::NONE &&
+      (vocabulary_size || enumerate || shuffle || constrained)) {
+    std::cerr << "generator: --ipa only transcribes sampled words, without constraints\n";
+    return 1;
   }
-  return 0;
+  if (num_threads > 0 && (vocabulary_size || enumerate || shuffle || records)) {
+    std::cerr << "generator: --threads only applies to sampled words, not to --vocabulary-size, "
+                 "--enumerate, --shuffle or --records\n";
+    return 1;
+  }
+  if (records && (!mix.empty() || transcription != phonology::Transcription::NONE || unique ||
+                  vocabulary_size || enumerate || shuffle || constrained)) {
+    std::cerr << "generator: --records only writes sampled words of one language, without "
+                 "constraints, --ipa or --unique\n";
+    return 1;
+  }
+  if (read_records_path &&
+      (!positional.empty() || count || start || tag || image_path || !mix.empty() ||
+       write_image_path || records || transcription != phonology::Transcription::NONE || unique ||
+       vocabulary_size || enumerate || shuffle || constrained || num_threads > 0 || counts_path ||
+       write_counts_path)) {
+    std::cerr << "generator: --read-records only prints a record stream, to --output or --fd\n";
+    return 1;
+  }
+  // Otherwise the language is picked once, here; everything after runs specialized for it
+  std::unique_ptr<phonology::Language> language;
+  if (mix.empty()) {
+    std::string_view name = tag.value_or("fr-FR");
+    language = image_path ? phonology::Language::load(image_path) : phonology::Language::make(name);
+    if (!language) {
+      return unknown_language(name);
+    }
+  }
+  // --write-image saves the language as an image for --image to load
+  if (write_image_path) {
+    language->save(write_image_path);
+    return 0;
+  }
+  std::unique_ptr<phonology::OutputWriter> out;
+  auto open_output = [&] {
+    if (output_path) {
+      out = std::make_unique<phonology::OutputWriter>(output_path);
+    } else {
+      out = std::make_unique<phonology::OutputWriter>(output_fd < 0 ? STDOUT_FILENO : output_fd);
+    }
+  };
+  // --read-records prints the words of a record stream back as --ipa-syllables prints them
+  if (read_records_path) {
+    phonology::Image stream = phonology::Image::map_stream(read_records_path);
+    phonology::RecordView batch;
+    std::string word;
+    open_output();
+    for (std::span<const std::byte> rest = stream.bytes(); !rest.empty();) {
+      std::span<const std::byte> image = phonology::Image::next(rest);
+      rest = rest.subspan(image.size());
+      if (!batch.read(image)) {
+        std::cerr << "generator: " << read_records_path << " holds an inconsistent record batch\n";
+        return 1;
+      }
+      for (std::size_t i = 0; i < batch.size(); ++i) {
+        word.clear();
+        batch.transcribe(i, word);
+        word += delimiter;
+        out->write(word);
+      }
+    }
+    return 0;
+  }
+  Job job = {seed, first, num_words, max_num_syllables, delimiter, transcription};
+  job.tagged = tag_language;
+  std::unique_ptr<phonology::UniqueSet> seen;
+  if (unique) {
+    seen = std::make_unique<phonology::UniqueSet>(num_words);
+    job.unique = seen.get();
+  }
+  // Draws from the system itself, or through the constraints when any are given
+  auto generate = [&](const auto& source) {
+    Novelty novelty;
+    std::string word;
+    // Small default runs keep going through iostreams; anything else gets the raw writer
+    bool default_output = !output_path && output_fd < 0 && delimiter == '\n';
+    if (default_output && num_threads == 0 && num_words < kWordsPerChunk) {
+      for (uint64_t i = 0; i < num_words; ++i) {
+        word.clear();
+        if (!append_word(source, first + i, job, novelty, word)) {
+          break;
+        }
+        std::cout << word;
+      }
+    } else {
+      open_output();
+      if (num_threads > 0) {
+        generate_bulk(source, num_threads, job, *out);
+      } else {
+        for (uint64_t i = 0; i < num_words; ++i) {
+          word.clear();
+          if (!append_word(source, first + i, job, novelty, word)) {
+            break;
+          }
+          out->write(word);
+        }
+      }
+    }
+  };
+  // Exit status once generate has run, reporting why it stopped short
+  auto report = [&] {
+    if (job.unsatisfiable) {
+      std::cerr << "generator: found no word of up to " << max_num_syllables
+                << " syllables meeting the constraints\n";
+      return 1;
+    }
+    if (job.exhausted) {
+      std::cerr << "generator: stopped after " << seen->size()
+                << " unique words, the vocabulary of words of up to " << max_num_syllables
+                << " syllables is nearly exhausted\n";
+      return 1;
+    }
+    return 0;
+  };
+  // --mix draws every word from one of several languages
+  if (!mix.empty()) {
+    generate(phonology::Mixer(std::move(mix), tag_language));
+    return report();
+  }
+
+  // Called once with the concrete System behind the language
+  auto run = [&](const auto& system) -> int {
+    // --records writes the words with their structure as a binary record stream, a batch per
+    // chunk of words
+    if (records) {
+      open_output();
+      phonology::RecordBatch batch;
+      for (uint64_t i = 0; i < num_words; ++i) {
+        phonology::Rng rng = phonology::counter_rng(seed, first + i);
+        phonology::get_record(system, rng, max_num_syllables, batch);
+        if (batch.size() == kWordsPerChunk || i + 1 == num_words) {
+          batch.write(*out);
+          batch.clear();
+        }
+      }
+      return 0;
+    }
+
+    // --write-counts saves the counts --shuffle numbers the vocabulary by, so that every shard of
+    // it can load them with --counts instead of counting again
+    if (write_counts_path) {
+      phonology::Vocabulary(system, max_num_syllables).save_counts(write_counts_path);
+      return 0;
+    }
+
+    // --vocabulary-size and --enumerate describe every word of up to max_num_syllables instead of
+    // sampling
+    if (vocabulary_size || enumerate) {
+      phonology::Vocabulary vocabulary(system, max_num_syllables);
+      if (counts_path) {
+        vocabulary.load_counts(phonology::Image::map(counts_path));
+      }
+      if (vocabulary_size) {
+        auto describe = [](phonology::Vocabulary::Count n) {
+          return (n == phonology::Vocabulary::kMaxCount ? "at least " : "") +
+                 phonology::to_string(n);
+        };
+        std::cout << describe(vocabulary.num_words()) << " words from "
+                  << describe(vocabulary.num_derivations()) << " derivations of up to "
+                  << max_num_syllables << " syllables\n";
+      }
+      if (enumerate) {
+        open_output();
+        char probability[32];
+        vocabulary.for_each_word([&](std::string_view word, double p) {
+          out->write(word);
+          out->put('\t');
+          out->write(std::string_view(probability,
+                                      std::snprintf(probability, sizeof(probability), "%.6g", p)));
+          out->put(delimiter);
+        });
+      }
+      return 0;
+    }
+
+    // --shuffle visits the numbered vocabulary through a random permutation, so every word is
+    // distinct without remembering any of them
+    if (shuffle) {
+      phonology::Vocabulary vocabulary(system, max_num_syllables);
+      if (counts_path) {
+        vocabulary.load_counts(phonology::Image::map(counts_path));
+      }
+      phonology::Vocabulary::Count size = vocabulary.num_words();
+      if (size == phonology::Vocabulary::kMaxCount) {
+        std::cerr << "generator: too many words of up to " << max_num_syllables
+                  << " syllables to number\n";
+        return 1;
+      }
+      phonology::FeistelPermutation permutation(size, seed);
+      open_output();
+      std::string word;
+      for (uint64_t i = first; i < first + num_words && i < size; ++i) {
+        word.clear();
+        vocabulary.word_at(permutation(i), word);
+        word += delimiter;
+        out->write(word);
+      }
+      if (first + num_words > size) {
+        std::cerr << "generator: stopped after all " << phonology::to_string(size)
+                  << " words of up to " << max_num_syllables << " syllables\n";
+        return 1;
+      }
+      return 0;
+    }
+
+    if (constrained) {
+      generate(phonology::Constrained(system, std::move(constraints)));
+    } else {
+      generate(system);
+    }
+    return report();
+  };
+  return language->visit(run);
 }
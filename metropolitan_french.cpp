@@ -10,262 +10,161 @@
 
 namespace phonology {
 
-static bool before_i_or_e(Spelling::RuleParams rp) {
-  return rp.next && rp.next->vowel && rp.next->rounded == VR::UNROUNDED &&
-         (rp.next->height == VH::CLOSE || rp.next->height == VH::CLOSE_MID ||
-          rp.next->height == VH::MID || rp.next->height == VH::OPEN_MID);
-}
-
-static bool not_before_i_or_e(Spelling::RuleParams rp) { return !before_i_or_e(rp); }
-
 void MetropolitanFrench::init_phonemes() {
   using enum IPA;
 
-  phonemes.emplace_back(get_phone(i),
-                        std::vector<Spelling>{{"i", any_position}, {"ie", word_final}});
-  phonemes.emplace_back(
-      get_phone(y),
-      std::vector<Spelling>{{"u", any_position}, {"û", mid_word}, {"ue", word_final}});
-  phonemes.emplace_back(
-      get_phone(e),
-      std::vector<Spelling>({{"é", any_position}, {"e", mid_word}, {"er", word_final}}));
-  phonemes.emplace_back(
-      get_phone(ø),
-      std::vector<Spelling>({{"eu", any_position},
-                             {"eû", [](Spelling::RuleParams rp) { return !word_final(rp); }},
-                             {"œu", mid_word}}));
-  phonemes.emplace_back(
-      get_phone(œ),
-      std::vector<Spelling>(
-          {{"eu", any_position},
-           {"eû", [](Spelling::RuleParams rp) { return !word_final(rp); }},
-           {"œu",
-            [](Spelling::RuleParams rp) { return mid_word(rp) && rp.prev->symbol != IPA::j; }},
-           {"œ", mid_word}}));
-
-  phonemes.emplace_back(
-      get_phone(a),
-      std::vector<Spelling>(
-          {{"a", [](Spelling::RuleParams rp) { return !rp.prev || (rp.prev->symbol != IPA::w); }},
-           {"à", [](Spelling::RuleParams rp) { return !rp.prev || (rp.prev->symbol != IPA::w); }},
-           {"â",
-            [](Spelling::RuleParams rp) {
-              return (!rp.prev || (rp.prev->symbol != IPA::w)) && rp.next;
-            }},
-           {"", [](Spelling::RuleParams rp) { return rp.prev && (rp.prev->symbol == IPA::w); }}}));
-
-  phonemes.emplace_back(get_phone(ɔ), std::vector<Spelling>({{"o", any_position}}));
-
-  phonemes.emplace_back(get_phone(o), std::vector<Spelling>({{"au", any_position},
-                                                             {"eau", any_position},
-                                                             {"o", any_position},
-                                                             {"ô", not_word_final}}));
-
-  phonemes.emplace_back(
-      get_phone(u),
-      std::vector<Spelling>({{"ou", any_position}, {"oû", not_word_final}, {"oue", word_final}}));
-
-  phonemes.emplace_back(get_phone(ɛ), std::vector<Spelling>({{"e", any_position},
-                                                             {"ai", any_position},
-                                                             {"aî", not_word_final},
-                                                             {"è", mid_word},
-                                                             {"ê", not_word_final},
-                                                             {"ei", mid_word}}));
-
-  phonemes.emplace_back(get_phone(ə), std::vector<Spelling>({{"e", any_position}}));
-
-  auto not_before_glide = [](Spelling::RuleParams rp) {
-    return !rp.prev ||
-           (rp.prev->symbol != IPA::w && rp.prev->symbol != IPA::ɥ && rp.prev->symbol != IPA::j);
-  };
-  phonemes.emplace_back(
-      get_phone(ɛ̃),
-      std::vector<Spelling>(
-          {{"ain", not_before_glide},
-           {"aim", not_before_glide},
-           {"um", not_before_glide},
-           {"un", not_before_glide},
-           {"ain", not_before_glide},
-           {"ein", not_before_glide},
-           {"im",
-            [](Spelling::RuleParams rp) {
-              return !rp.prev || (rp.prev->symbol != IPA::j && rp.prev->symbol != IPA::w);
-            }},
-           {"in",
-            [](Spelling::RuleParams rp) {
-              return !rp.prev || (rp.prev->symbol != IPA::j && rp.prev->symbol != IPA::w);
-            }},
-           {"în",
-            [](Spelling::RuleParams rp) {
-              return rp.prev && (rp.prev->symbol != IPA::j && rp.prev->symbol != IPA::w);
-            }},
-           {"en", [](Spelling::RuleParams rp) { return rp.prev && rp.prev->symbol == IPA::j; }},
-           {"oin", [](Spelling::RuleParams rp) { return rp.prev && rp.prev->symbol == IPA::w; }}}));
-
-  phonemes.emplace_back(get_phone(ɔ̃),
-                        std::vector<Spelling>({{"on", any_position}, {"om", any_position}}));
-
-  phonemes.emplace_back(get_phone(ɑ̃), std::vector<Spelling>({{"an", any_position},
-                                                             {"am", any_position},
-                                                             {"en", any_position},
-                                                             {"em", any_position}}));
-
-  phonemes.emplace_back(
+  // Silent final consonants, as in "petit" or "tabac"
+  silent_letters = "dgpstxz";
+
+  add_phoneme(get_phone(i), std::vector<Spelling>{{"i", any_position}, {"ie", word_final}});
+  add_phoneme(get_phone(y), std::vector<Spelling>{{"u", any_position},
+                                                  {"û", mid_word, 0.25},
+                                                  {"ue", word_final}});
+  add_phoneme(get_phone(e),
+              std::vector<Spelling>({{"é", any_position}, {"e", mid_word}, {"er", word_final}}));
+  add_phoneme(get_phone(ø), std::vector<Spelling>({{"eu", any_position},
+                                                   {"eû", not_word_final, 0.25},
+                                                   {"œu", mid_word}}));
+  add_phoneme(get_phone(œ), std::vector<Spelling>({{"eu", any_position},
+                                                   {"eû", not_word_final, 0.25},
+                                                   {"œu", mid_word & ~after_j},
+                                                   {"œ", mid_word}}));
+
+  add_phoneme(get_phone(a), std::vector<Spelling>({{"a", ~after_w},
+                                                   {"à", ~after_w},
+                                                   {"â", ~after_w & ~is_coda, 0.25},
+                                                   {"", after_w}}));
+
+  add_phoneme(get_phone(ɔ), std::vector<Spelling>({{"o", any_position}}));
+
+  add_phoneme(get_phone(o), std::vector<Spelling>({{"au", any_position},
+                                                   {"eau", any_position},
+                                                   {"o", any_position},
+                                                   {"ô", not_word_final, 0.25}}));
+
+  add_phoneme(get_phone(u), std::vector<Spelling>({{"ou", any_position},
+                                                   {"oû", not_word_final, 0.25},
+                                                   {"oue", word_final}}));
+
+  add_phoneme(get_phone(ɛ), std::vector<Spelling>({{"e", any_position},
+                                                   {"ai", any_position},
+                                                   {"aî", not_word_final, 0.25},
+                                                   {"è", mid_word},
+                                                   {"ê", not_word_final},
+                                                   {"ei", mid_word}}));
+
+  add_phoneme(get_phone(ə), std::vector<Spelling>({{"e", any_position}}));
+
+  auto not_before_glide = ~(after_w | after_ɥ | after_j);
+  add_phoneme(get_phone(ɛ̃), std::vector<Spelling>({{"ain", not_before_glide},
+                                                    {"aim", not_before_glide},
+                                                    {"um", not_before_glide},
+                                                    {"un", not_before_glide},
+                                                    {"ain", not_before_glide},
+                                                    {"ein", not_before_glide},
+                                                    {"im", ~(after_j | after_w)},
+                                                    {"in", ~(after_j | after_w)},
+                                                    {"în", not_word_initial & ~(after_j | after_w)},
+                                                    {"en", after_j},
+                                                    {"n", after_w}}));
+
+  add_phoneme(get_phone(ɔ̃), std::vector<Spelling>({{"on", any_position}, {"om", any_position}}));
+
+  add_phoneme(get_phone(ɑ̃), std::vector<Spelling>({{"an", any_position},
+                                                    {"am", any_position},
+                                                    {"en", any_position},
+                                                    {"em", any_position}}));
+
+  add_phoneme(
       get_phone(m),
-      std::vector<Spelling>({{"m",
-                              [](Spelling::RuleParams rp) {
-                                if (rp.word_final) {
-                                  return false;
-                                }
-                                if (rp.prev && rp.prev->vowel && rp.next->vowel) {
-                                  return false;
-                                }
-                                return true;
-                              }},
-                             {"mm",
-                              [](Spelling::RuleParams rp) {
-                                return (rp.prev && rp.next && rp.prev->vowel && rp.next->vowel);
-                              }},
+      std::vector<Spelling>({{"m", not_word_final & ~(after_vowel & before_vowel)},
+                             {"mm", after_vowel & before_vowel},
                              {"me", word_final},
                              {"mme", word_final}}));
 
-  phonemes.emplace_back(
+  add_phoneme(
       get_phone(n),
-      std::vector<Spelling>({{"n",
-                              [](Spelling::RuleParams rp) {
-                                if (rp.word_final) {
-                                  return false;
-                                }
-                                if (rp.prev && rp.prev->vowel && rp.next->vowel) {
-                                  return false;
-                                }
-                                return true;
-                              }},
-                             {"nn",
-                              [](Spelling::RuleParams rp) {
-                                return (rp.prev && rp.next && rp.prev->vowel && rp.next->vowel);
-                              }},
+      std::vector<Spelling>({{"n", not_word_final & ~(after_vowel & before_vowel)},
+                             {"nn", after_vowel & before_vowel},
                              {"ne", word_final},
                              {"nne", word_final}}));
 
-  phonemes.emplace_back(get_phone(ɲ),
-                        std::vector<Spelling>({{"gn", not_word_final}, {"gne", word_final}}));
+  add_phoneme(get_phone(ɲ), std::vector<Spelling>({{"gn", not_word_final}, {"gne", word_final}}));
 
-  phonemes.emplace_back(
-      get_phone(p),
-      std::vector<Spelling>({{"p", not_word_final}, {"pp", between_vowels}, {"pe", word_final}}));
+  add_phoneme(get_phone(p), std::vector<Spelling>({{"p", not_word_final},
+                                                   {"pp", between_vowels},
+                                                   {"pe", word_final}}));
 
-  phonemes.emplace_back(get_phone(t), std::vector<Spelling>({{"t", not_word_final},
-                                                             {"tt", between_vowels},
-                                                             {"te", word_final},
-                                                             {"tte", [](Spelling::RuleParams rp) {
-                                                                return word_final(rp) &&
-                                                                       not_in_cluster(rp);
-                                                              }}}));
+  add_phoneme(get_phone(t), std::vector<Spelling>({{"t", not_word_final},
+                                                   {"tt", between_vowels},
+                                                   {"te", word_final},
+                                                   {"tte", word_final & not_in_cluster}}));
 
-  phonemes.emplace_back(
+  add_phoneme(
       get_phone(k),
-      std::vector<Spelling>(
-          {{"c",
-            [](Spelling::RuleParams rp) {
-              return not_before_i_or_e(rp) && (!word_final(rp) || not_in_cluster(rp));
-            }},
-           {"cc",
-            [](Spelling::RuleParams rp) { return not_before_i_or_e(rp) && between_vowels(rp); }},
-           {"qu", before_vowel},
-           {"que", word_final}}));
-
-  phonemes.emplace_back(
-      get_phone(b),
-      std::vector<Spelling>({{"b", not_word_final}, {"bb", between_vowels}, {"be", word_final}}));
-
-  phonemes.emplace_back(
-      get_phone(d),
-      std::vector<Spelling>({{"d", not_word_final}, {"dd", between_vowels}, {"de", word_final}}));
-
-  phonemes.emplace_back(
-      get_phone(g),
-      std::vector<Spelling>(
-          {{"g",
-            [](Spelling::RuleParams rp) { return not_before_i_or_e(rp) && not_word_final(rp); }},
-           {"gu", before_i_or_e},
-           {"gg",
-            [](Spelling::RuleParams rp) { return not_before_i_or_e(rp) && between_vowels(rp); }},
-           {"gue", word_final}}));
-
-  phonemes.emplace_back(get_phone(f), std::vector<Spelling>({{"f", any_position},
-                                                             {"ph", not_word_final},
-                                                             {"ff", between_vowels},
-                                                             {"fe", word_final},
-                                                             {"phe", word_final}}));
-
-  phonemes.emplace_back(
+      std::vector<Spelling>({{"c", not_before_i_or_e & (not_word_final | not_in_cluster)},
+                             {"cc", not_before_i_or_e & between_vowels},
+                             {"qu", before_vowel},
+                             {"que", word_final}}));
+
+  add_phoneme(get_phone(b), std::vector<Spelling>({{"b", not_word_final},
+                                                   {"bb", between_vowels},
+                                                   {"be", word_final}}));
+
+  add_phoneme(get_phone(d), std::vector<Spelling>({{"d", not_word_final},
+                                                   {"dd", between_vowels},
+                                                   {"de", word_final}}));
+
+  add_phoneme(get_phone(g), std::vector<Spelling>({{"g", not_before_i_or_e & not_word_final},
+                                                   {"gu", before_i_or_e},
+                                                   {"gg", not_before_i_or_e & between_vowels},
+                                                   {"gue", word_final}}));
+
+  add_phoneme(get_phone(f), std::vector<Spelling>({{"f", any_position},
+                                                   {"ph", not_word_final},
+                                                   {"ff", between_vowels},
+                                                   {"fe", word_final},
+                                                   {"phe", word_final}}));
+
+  add_phoneme(
       get_phone(s),
-      std::vector<Spelling>(
-          {{"s", not_word_final},
-           {"ç",
-            [](Spelling::RuleParams rp) {
-              return not_in_cluster(rp) && not_before_i_or_e(rp) && not_word_final(rp);
-            }},
-           {"c", [](Spelling::RuleParams rp) { return not_in_cluster(rp) && before_i_or_e(rp); }},
-           {"ss", between_vowels},
-           {"se", word_final},
-           {"sse", [](Spelling::RuleParams rp) { return word_final(rp) && not_in_cluster(rp); }},
-           {"ce", [](Spelling::RuleParams rp) { return word_final(rp) && not_in_cluster(rp); }}}));
-
-  phonemes.emplace_back(get_phone(ʃ),
-                        std::vector<Spelling>({{"ch", not_word_final}, {"che", word_final}}));
-
-  phonemes.emplace_back(get_phone(v),
-                        std::vector<Spelling>({{"v", not_word_final}, {"ve", word_final}}));
-
-  phonemes.emplace_back(
-      get_phone(z),
-      std::vector<Spelling>({{"z", not_word_final}, {"s", mid_word}, {"se", word_final}}));
-
-  phonemes.emplace_back(get_phone(ʒ), std::vector<Spelling>({{"j",
-                                                              [](Spelling::RuleParams rp) {
-                                                                return not_before_i_or_e(rp) &&
-                                                                       not_word_final(rp);
-                                                              }},
-                                                             {"g", before_i_or_e},
-                                                             {"ge", word_final}}));
-
-  phonemes.emplace_back(
-      get_phone(l),
-      std::vector<Spelling>(
-          {{"l", [](Spelling::RuleParams rp) { return not_word_final(rp) || not_in_cluster(rp); }},
-           {"ll", between_vowels},
-           {"le", word_final},
-           {"lle", [](Spelling::RuleParams rp) { return word_final(rp) && not_in_cluster(rp); }}}));
-
-  phonemes.emplace_back(get_phone(ʁ̞), std::vector<Spelling>({{"r", not_word_final},
-                                                             {"rr", between_vowels},
-                                                             {"re", word_final},
-                                                             {"rre", [](Spelling::RuleParams rp) {
-                                                                return word_final(rp) &&
-                                                                       not_in_cluster(rp);
-                                                              }}}));
-
-  phonemes.emplace_back(
-      get_phone(j), std::vector<Spelling>(
-                        {{"i", [](Spelling::RuleParams rp) { return not_word_initial(rp); }},
-                         {"y", word_initial},
-                         {"il",
-                          [](Spelling::RuleParams rp) {
-                            return rp.prev && rp.prev->vowel && (rp.prev->backness == VB::FRONT);
-                          }},
-                         {"ille", [](Spelling::RuleParams rp) {
-                            return rp.prev && !rp.next && rp.prev->vowel &&
-                                   (rp.prev->backness == VB::FRONT);
-                          }}}));
-
-  phonemes.emplace_back(get_phone(ɥ),
-                        std::vector<Spelling>({{"u", not_word_initial}, {"hu", word_initial}}));
-
-  phonemes.emplace_back(get_phone(w), std::vector<Spelling>({
-                                          {"oi", any_position},
-                                      }));
+      std::vector<Spelling>({{"s", not_word_final},
+                             {"ç", not_in_cluster & not_before_i_or_e & not_word_final},
+                             {"c", not_in_cluster & before_i_or_e},
+                             {"ss", between_vowels},
+                             {"se", word_final},
+                             {"sse", word_final & not_in_cluster},
+                             {"ce", word_final & not_in_cluster}}));
+
+  add_phoneme(get_phone(ʃ), std::vector<Spelling>({{"ch", not_word_final}, {"che", word_final}}));
+
+  add_phoneme(get_phone(v), std::vector<Spelling>({{"v", not_word_final}, {"ve", word_final}}));
+
+  add_phoneme(get_phone(z),
+              std::vector<Spelling>({{"z", not_word_final}, {"s", mid_word}, {"se", word_final}}));
+
+  add_phoneme(get_phone(ʒ), std::vector<Spelling>({{"j", not_before_i_or_e & not_word_final},
+                                                   {"g", before_i_or_e},
+                                                   {"ge", word_final}}));
+
+  add_phoneme(get_phone(l), std::vector<Spelling>({{"l", not_word_final | not_in_cluster},
+                                                   {"ll", between_vowels},
+                                                   {"le", word_final},
+                                                   {"lle", word_final & not_in_cluster}}));
+
+  add_phoneme(get_phone(ʁ̞), std::vector<Spelling>({{"r", not_word_final},
+                                                    {"rr", between_vowels},
+                                                    {"re", word_final},
+                                                    {"rre", word_final & not_in_cluster}}));
+
+  add_phoneme(get_phone(j), std::vector<Spelling>({{"i", not_word_initial},
+                                                   {"y", word_initial},
+                                                   {"il", after_front_vowel},
+                                                   {"ille", after_front_vowel & is_coda}}));
+
+  add_phoneme(get_phone(ɥ), std::vector<Spelling>({{"u", not_word_initial}, {"hu", word_initial}}));
+
+  add_phoneme(get_phone(w), std::vector<Spelling>({{"oi", any_position}}));
 
   // clang-format on
 }
@@ -284,9 +183,7 @@ void MetropolitanFrench::init_onsets() {
   {
     // Stop, or non-sibilant fricative, plus /r/
     onsets.emplace_back();
-    auto start = consonants |
-                 std::views::filter([](const auto& p) { return fricative(p) || stop(p); }) |
-                 std::views::filter([](const auto& p) { return !sibilant(p); });
+    auto start = consonants | std::views::filter((fricative | stop) & ~sibilant);
     auto r = get_phoneme(IPA::ʁ̞);
     for (const auto& c : start) {
       onsets.back().emplace_back();
@@ -326,7 +223,7 @@ void MetropolitanFrench::init_onsets() {
     // Consonant plus /w/
     onsets.emplace_back();
     auto candidates =
-        consonants | std::views::filter(except({IPA::ɲ, IPA::g, IPA::z, IPA::j, IPA::ɥ, IPA::w}));
+        consonants | std::views::filter(except(IPA::ɲ, IPA::g, IPA::z, IPA::j, IPA::ɥ, IPA::w));
     auto w = get_phoneme(IPA::w);
     for (const auto& c : candidates) {
       onsets.back().emplace_back();
@@ -338,7 +235,7 @@ void MetropolitanFrench::init_onsets() {
     // Consonant plus /ɥ/
     onsets.emplace_back();
     auto candidates =
-        consonants | std::views::filter(except({IPA::ɲ, IPA::g, IPA::z, IPA::j, IPA::ɥ, IPA::w}));
+        consonants | std::views::filter(except(IPA::ɲ, IPA::g, IPA::z, IPA::j, IPA::ɥ, IPA::w));
     auto ɥ = get_phoneme(IPA::ɥ);
     for (const auto& c : candidates) {
       onsets.back().emplace_back();
@@ -351,7 +248,7 @@ void MetropolitanFrench::init_onsets() {
     onsets.emplace_back();
     auto candidates =
         consonants |
-        std::views::filter(except({IPA::ɲ, IPA::g, IPA::z, IPA::ʒ, IPA::j, IPA::ɥ, IPA::w}));
+        std::views::filter(except(IPA::ɲ, IPA::g, IPA::z, IPA::ʒ, IPA::j, IPA::ɥ, IPA::w));
     auto j = get_phoneme(IPA::j);
     for (const auto& c : candidates) {
       onsets.back().emplace_back();
@@ -385,24 +282,23 @@ void MetropolitanFrench::init_nuclei() {
     // While other sequences are possible, e.g. oui (/wi/), ouais (/wɛ/),
     // these can be evaluated as /u/ + vowel, and so their spelling would look
     // correct, whereas there is no way to generate "oi" from /wa/
-    nucleus_index_map[get_phoneme(IPA::w)] = nuclei.size();
+    nucleus_group[index_of(get_phoneme(IPA::w))] = nuclei.size();
     nuclei.emplace_back();
     nuclei.back().push_back(get_phoneme(IPA::a));
-    nuclei.emplace_back();
     nuclei.back().push_back(get_phoneme(IPA::ɛ̃));
   }
   {
     // Following /ɥ/, only /i/
-    nucleus_index_map[get_phoneme(IPA::ɥ)] = nuclei.size();
+    nucleus_group[index_of(get_phoneme(IPA::ɥ))] = nuclei.size();
     nuclei.emplace_back();
     nuclei.back().push_back(get_phoneme(IPA::i));
   }
   {
     // Following /j/, only mid and close-mid front vowels except /œ/
-    nucleus_index_map[get_phoneme(IPA::j)] = nuclei.size();
+    nucleus_group[index_of(get_phoneme(IPA::j))] = nuclei.size();
     nuclei.emplace_back();
-    auto candidates = std::views::all(phonemes) | std::views::filter(front) |
-                      std::views::filter(any_mid) | std::views::filter(except(IPA::œ));
+    auto candidates = std::views::all(phonemes) |
+                      std::views::filter(front & any_mid & except(IPA::œ));
     for (const auto& c : candidates) {
       nuclei.back().push_back(&c);
     }
@@ -414,7 +310,7 @@ void MetropolitanFrench::init_codas() {
   {
     // All single consonants except /w/ and /ɥ/
     codas.emplace_back();
-    auto candidates = consonants | std::views::filter(except({IPA::w, IPA::ɥ}));
+    auto candidates = consonants | std::views::filter(except(IPA::w, IPA::ɥ));
     for (auto& c : candidates) {
       codas.back().emplace_back();
       codas.back().back().push_back(&c);
@@ -488,9 +384,8 @@ void MetropolitanFrench::init_codas() {
   {
     // Non-alveolar voiceless stop plus voiceless alveolar
     codas.emplace_back();
-    auto start = consonants | std::views::filter(voiceless) | std::views::filter(stop) |
-                 std::views::filter([](const auto& p) { return !alveolar(p); });
-    auto last = consonants | std::views::filter(voiceless) | std::views::filter(alveolar);
+    auto start = consonants | std::views::filter(voiceless & stop & ~alveolar);
+    auto last = consonants | std::views::filter(voiceless & alveolar);
     for (const auto& s : start) {
       for (const auto& l : last) {
         codas.back().emplace_back();
@@ -501,11 +396,11 @@ void MetropolitanFrench::init_codas() {
   }
   {
     // After nasal vowel, only stops and non-labial fricatives
-    auto nasals = consonants | std::views::filter(nasal_v);
+    auto nasals = std::views::all(phonemes) | std::views::filter(nasal_v);
     for (const auto& n : nasals) {
-      coda_index_map[&n] = codas.size();
+      coda_group[index_of(&n)] = codas.size();
     }
-    auto f = std::views::filter([](const std::vector<const Phoneme*>& p) {
+    auto f = std::views::filter([](const Cluster& p) {
       return stop(*p.front()) || (fricative(*p.front()) && !labial(*p.front()));
     });
     codas.emplace_back();
@@ -517,81 +412,4 @@ void MetropolitanFrench::init_codas() {
   }
 }
 
-std::vector<const Phoneme*> MetropolitanFrench::get_onset() const {
-  std::vector<const Phoneme*> onset;
-  int i = rand() % onsets.size();
-  int j = rand() % onsets[i].size();
-  for (auto p : onsets[i][j]) {
-    onset.push_back(p);
-  }
-  return onset;
-}
-
-const Phoneme* MetropolitanFrench::get_nucleus(const Phoneme* onset) const {
-  if (auto it = nucleus_index_map.find(onset); it != nucleus_index_map.end()) {
-    std::size_t i = it->second;
-    std::size_t j = rand() % nuclei[i].size();
-    return nuclei[i][j];
-  }
-  std::size_t i = rand() % nuclei.front().size();
-  return nuclei.front()[i];
-}
-
-std::vector<const Phoneme*> MetropolitanFrench::get_coda(const Phoneme* nucleus) const {
-  if (rand() % 2) {
-    return {};
-  }
-  std::vector<const Phoneme*> coda;
-  std::size_t i = rand() % codas.size();
-  if (auto it = coda_index_map.find(nucleus); it != coda_index_map.end()) {
-    i = it->second;
-  }
-  int j = rand() % codas[i].size();
-  for (auto p : codas[i][j]) {
-    coda.push_back(p);
-  }
-  return coda;
-}
-
-std::string MetropolitanFrench::get_spelling(const Syllable& syllable, bool word_final) const {
-  std::string x;
-  Spelling::RuleParams rp;
-  rp.prev = nullptr;
-  rp.word_final = false;
-  for (std::size_t i = 0; i < syllable.onset.size(); ++i) {
-    rp.next = i == syllable.onset.size() - 1 ? &syllable.nucleus->p : &syllable.onset[i + 1]->p;
-    x += syllable.onset[i]->GetSpelling(rp);
-    rp.prev = &syllable.onset[i]->p;
-  }
-
-  if (syllable.coda.size()) {
-    rp.next = &syllable.coda.front()->p;
-  } else {
-    rp.next = nullptr;
-    rp.word_final = word_final;
-  }
-  x += syllable.nucleus->GetSpelling(rp);
-  rp.prev = &syllable.nucleus->p;
-
-  if (word_final && !syllable.coda.size()) {
-    if (rand() % 2) {
-      int i = rand() % silent_final_letters.size();
-      x += silent_final_letters[i];
-    }
-  }
-
-  for (std::size_t i = 0; i < syllable.coda.size(); ++i) {
-    if (i == syllable.coda.size() - 1) {
-      rp.next = nullptr;
-      rp.word_final = word_final;
-    } else {
-      rp.next = &syllable.coda[i + 1]->p;
-    }
-    x += syllable.coda[i]->GetSpelling(rp);
-    rp.prev = &syllable.coda[i]->p;
-  }
-
-  return x;
-}
-
 }  // namespace phonology
@@ -0,0 +1,30 @@
+#include "mixer.hpp"
+
+#include <cassert>
+#include <cstdint>
+#include <utility>
+
+namespace phonology {
+
+// Public functions
+
+Mixer::Mixer(std::vector<Component> components, bool tag)
+    : components(std::move(components)), tag(tag) {
+  std::vector<double> weights;
+  for (const Component& c : this->components) {
+    weights.push_back(c.weight);
+  }
+  sampler.add(weights);
+}
+
+void Mixer::generate_batch(Rng& rng, std::size_t n, int max_num_syllables,
+                           WordBatch& out) const {
+  out.offsets.reserve(out.offsets.size() + n);
+  for (std::size_t i = 0; i < n; ++i) {
+    get_word(rng, max_num_syllables, out.chars);
+    assert(out.chars.size() <= UINT32_MAX);
+    out.offsets.push_back(out.chars.size());
+  }
+}
+
+}  // namespace phonology
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "language.hpp"
+#include "phonology.hpp"
+#include "random.hpp"
+
+namespace phonology {
+
+// Interleaves the words of several languages: each word comes from a language drawn with fixed
+// weights from an alias table, using the same Rng as the word itself, and is appended to the same
+// buffer. Picking the language is a switch on its kind rather than a virtual call, so every word
+// is still drawn through the specialized path of its System. Only reads the languages, so one
+// instance can be shared between threads.
+class Mixer {
+ public:
+  struct Component {
+    std::unique_ptr<Language> language;
+    double weight;
+  };
+
+  // With tag set, every word is preceded by the tag of its language and a tab
+  Mixer(std::vector<Component> components, bool tag);
+
+  // Appends a word of a language drawn by weight to out
+  void get_word(Rng& rng, int max_num_syllables, std::string& out,
+                Transcription transcription = Transcription::NONE) const {
+    std::size_t i = sampler.view().sample(0, components.size(), rng);
+    const Language& language = *components[i].language;
+    if (tag) {
+      out += language.tag();
+      out += '\t';
+    }
+    language.visit([&](const auto& system) {
+      phonology::get_word(system, rng, max_num_syllables, out, transcription);
+    });
+  }
+
+  // Appends n words to out, as generate_batch does for a single language
+  void generate_batch(Rng& rng, std::size_t n, int max_num_syllables, WordBatch& out) const;
+
+ private:
+  std::vector<Component> components;
+  AliasTablesBuilder sampler;
+  bool tag;
+};
+
+}  // namespace phonology
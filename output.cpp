@@ -0,0 +1,92 @@
+#include "output.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace phonology {
+
+OutputWriter::OutputWriter(int fd, std::size_t capacity) : fd(fd), buffer(capacity) {}
+
+OutputWriter::OutputWriter(const char* path, std::size_t capacity)
+    : fd(open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)),
+      owns_fd(true),
+      buffer(capacity) {
+  if (fd < 0) {
+    std::fprintf(stderr, "output: cannot open %s: %s\n", path, std::strerror(errno));
+    std::abort();
+  }
+}
+
+OutputWriter::~OutputWriter() {
+  flush();
+  if (owns_fd) {
+    close(fd);
+  }
+}
+
+void OutputWriter::write(std::string_view data) {
+  if (data.size() <= buffer.size() - size) {
+    std::memcpy(buffer.data() + size, data.data(), data.size());
+    size += data.size();
+    return;
+  }
+  if (data.size() < buffer.size()) {
+    flush();
+    std::memcpy(buffer.data(), data.data(), data.size());
+    size = data.size();
+    return;
+  }
+  iovec iov[2] = {{buffer.data(), size}, {const_cast<char*>(data.data()), data.size()}};
+  write_all(iov, 2);
+  size = 0;
+}
+
+void OutputWriter::write(std::span<const iovec> blocks) {
+  assert(blocks.size() <= kMaxBlocks);
+  iovec iov[kMaxBlocks + 1] = {{buffer.data(), size}};
+  std::ranges::copy(blocks, iov + 1);
+  write_all(iov, blocks.size() + 1);
+  size = 0;
+}
+
+void OutputWriter::flush() {
+  if (size == 0) {
+    return;
+  }
+  iovec iov = {buffer.data(), size};
+  write_all(&iov, 1);
+  size = 0;
+}
+
+void OutputWriter::write_all(iovec* next, int count) {
+  while (count) {
+    ssize_t written = writev(fd, next, count);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      std::fprintf(stderr, "output: write failed: %s\n", std::strerror(errno));
+      std::abort();
+    }
+    // Skip the blocks that went out in full and trim the one that went out in part
+    std::size_t n = written;
+    while (count && n >= next->iov_len) {
+      n -= next->iov_len;
+      ++next;
+      --count;
+    }
+    if (count) {
+      next->iov_base = static_cast<char*>(next->iov_base) + n;
+      next->iov_len -= n;
+    }
+  }
+}
+
+}  // namespace phonology
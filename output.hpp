@@ -0,0 +1,49 @@
+#pragma once
+
+#include <sys/uio.h>
+
+#include <cstddef>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace phonology {
+
+// Buffered writer on a raw file descriptor. Output is collected in a large buffer and handed to
+// the kernel with write(2); blocks too large for the buffer go out together with whatever is
+// pending in a single writev(2). Write failures are fatal.
+class OutputWriter {
+ public:
+  static constexpr std::size_t kDefaultCapacity = 4 << 20;
+  static constexpr std::size_t kMaxBlocks = 63;
+
+  explicit OutputWriter(int fd, std::size_t capacity = kDefaultCapacity);
+  // Opens (creating or truncating) the file at path
+  explicit OutputWriter(const char* path, std::size_t capacity = kDefaultCapacity);
+  OutputWriter(const OutputWriter&) = delete;
+  OutputWriter& operator=(const OutputWriter&) = delete;
+  ~OutputWriter();
+
+  void write(std::string_view data);
+  // Writes the blocks after whatever is pending in a single writev(2), without copying them into
+  // the buffer. At most kMaxBlocks of them.
+  void write(std::span<const iovec> blocks);
+  void put(char c) {
+    if (size == buffer.size()) {
+      flush();
+    }
+    buffer[size++] = c;
+  }
+  void flush();
+
+ private:
+  // Writes count blocks from next in full, advancing next past what has gone out
+  void write_all(iovec* next, int count);
+
+  int fd;
+  bool owns_fd = false;
+  std::vector<char> buffer;
+  std::size_t size = 0;
+};
+
+}  // namespace phonology
@@ -1,70 +1,156 @@
 #include "phonology.hpp"
 
+#include <algorithm>
 #include <cassert>
 #include <cstdlib>
-#include <unordered_map>
 
 namespace phonology {
 
-static const std::unordered_map<IPA, const Phone> phones = {
-    // clang-format off
-    {IPA::a,  Phone(IPA::a,  VR::UNROUNDED, VH::OPEN,         VB::FRONT,   VN::ORAL)},
-    {IPA::aɪ, Phone(IPA::aɪ, VR::UNROUNDED, VH::OPEN,         VB::FRONT,   VN::ORAL)},
-    {IPA::aʊ, Phone(IPA::aʊ, VR::UNROUNDED, VH::OPEN,         VB::FRONT,   VN::ORAL)},
-    {IPA::æ,  Phone(IPA::æ,  VR::UNROUNDED, VH::NEAR_OPEN,    VB::FRONT,   VN::ORAL)},
-    {IPA::ɛ,  Phone(IPA::ɛ,  VR::UNROUNDED, VH::OPEN_MID,     VB::FRONT,   VN::ORAL)},
-    {IPA::ɛ̃,  Phone(IPA::ɛ̃,  VR::UNROUNDED, VH::OPEN_MID,     VB::FRONT,   VN::NASAL)},
-    {IPA::œ,  Phone(IPA::œ,  VR::ROUNDED,   VH::OPEN_MID,     VB::FRONT,   VN::ORAL)},
-    {IPA::e,  Phone(IPA::e,  VR::UNROUNDED, VH::CLOSE_MID,    VB::FRONT,   VN::ORAL)},
-    {IPA::eɪ, Phone(IPA::eɪ, VR::UNROUNDED, VH::CLOSE_MID,    VB::FRONT,   VN::ORAL)},
-    {IPA::ø,  Phone(IPA::ø,  VR::ROUNDED,   VH::CLOSE_MID,    VB::FRONT,   VN::ORAL)},
-    {IPA::ɪ,  Phone(IPA::ɪ,  VR::UNROUNDED, VH::NEAR_CLOSE,   VB::FRONT,   VN::ORAL)},
-    {IPA::i,  Phone(IPA::i,  VR::UNROUNDED, VH::CLOSE,        VB::FRONT,   VN::ORAL)},
-    {IPA::y,  Phone(IPA::y,  VR::ROUNDED,   VH::CLOSE,        VB::FRONT,   VN::ORAL)},
-    {IPA::ɑ,  Phone(IPA::ɑ,  VR::UNROUNDED, VH::OPEN,         VB::BACK,    VN::ORAL)},
-    {IPA::ɑ̃,  Phone(IPA::ɑ̃,  VR::UNROUNDED, VH::OPEN,         VB::BACK,    VN::NASAL)},
-    {IPA::ɔ,  Phone(IPA::ɔ,  VR::ROUNDED,   VH::OPEN_MID,     VB::BACK,    VN::ORAL)},
-    {IPA::ɔ̃,  Phone(IPA::ɔ̃,  VR::ROUNDED,   VH::OPEN_MID,     VB::BACK,    VN::NASAL)},
-    {IPA::ɔɪ, Phone(IPA::ɔɪ, VR::ROUNDED,   VH::OPEN_MID,     VB::BACK,    VN::ORAL)},
-    {IPA::o,  Phone(IPA::o,  VR::ROUNDED,   VH::CLOSE_MID,    VB::BACK,    VN::ORAL)},
-    {IPA::oʊ, Phone(IPA::oʊ, VR::ROUNDED,   VH::CLOSE_MID,    VB::BACK,    VN::ORAL)},
-    {IPA::ʊ,  Phone(IPA::ʊ,  VR::ROUNDED,   VH::NEAR_CLOSE,   VB::BACK,    VN::ORAL)},
-    {IPA::ə,  Phone(IPA::ə,  VR::UNROUNDED, VH::MID,          VB::CENTRAL, VN::ORAL)},
-    {IPA::u,  Phone(IPA::u,  VR::ROUNDED,   VH::CLOSE,        VB::BACK,    VN::ORAL)},
-    {IPA::m,  Phone(IPA::m,  CV::VOICED,    MoA::NASAL,       PoA::LABIAL)},
-    {IPA::n,  Phone(IPA::n,  CV::VOICED,    MoA::NASAL,       PoA::ALVEOLAR)},
-    {IPA::ɲ,  Phone(IPA::ɲ,  CV::VOICED,    MoA::NASAL,       PoA::PALATAL)},
-    {IPA::ŋ,  Phone(IPA::ŋ,  CV::VOICED,    MoA::NASAL,       PoA::VELAR)},
-    {IPA::p,  Phone(IPA::p,  CV::VOICELESS, MoA::PLOSIVE,     PoA::LABIAL)},
-    {IPA::t,  Phone(IPA::t,  CV::VOICELESS, MoA::PLOSIVE,     PoA::ALVEOLAR)},
-    {IPA::tʃ, Phone(IPA::tʃ, CV::VOICELESS, MoA::AFFRICATE,   PoA::POST_ALVEOLAR)},
-    {IPA::k,  Phone(IPA::k,  CV::VOICELESS, MoA::PLOSIVE,     PoA::VELAR)},
-    {IPA::b,  Phone(IPA::b,  CV::VOICED,    MoA::PLOSIVE,     PoA::LABIAL)},
-    {IPA::d,  Phone(IPA::d,  CV::VOICED,    MoA::PLOSIVE,     PoA::ALVEOLAR)},
-    {IPA::dʒ, Phone(IPA::dʒ, CV::VOICED,    MoA::AFFRICATE,   PoA::POST_ALVEOLAR)},
-    {IPA::g,  Phone(IPA::g,  CV::VOICED,    MoA::PLOSIVE,     PoA::VELAR)},
-    {IPA::f,  Phone(IPA::f,  CV::VOICELESS, MoA::FRICATIVE,   PoA::LABIAL)},
-    {IPA::θ,  Phone(IPA::θ,  CV::VOICELESS, MoA::FRICATIVE,   PoA::DENTAL)},
-    {IPA::s,  Phone(IPA::s,  CV::VOICELESS, MoA::FRICATIVE,   PoA::ALVEOLAR)},
-    {IPA::ʃ,  Phone(IPA::ʃ,  CV::VOICELESS, MoA::FRICATIVE,   PoA::POST_ALVEOLAR)},
-    {IPA::h,  Phone(IPA::h,  CV::VOICELESS, MoA::FRICATIVE,   PoA::GLOTTAL)},
-    {IPA::v,  Phone(IPA::v,  CV::VOICED,    MoA::FRICATIVE,   PoA::LABIAL)},
-    {IPA::ð,  Phone(IPA::ð,  CV::VOICED,    MoA::FRICATIVE,   PoA::DENTAL)},
-    {IPA::z,  Phone(IPA::z,  CV::VOICED,    MoA::FRICATIVE,   PoA::ALVEOLAR)},
-    {IPA::ʒ,  Phone(IPA::ʒ,  CV::VOICED,    MoA::FRICATIVE,   PoA::POST_ALVEOLAR)},
-    {IPA::w,  Phone(IPA::w,  CV::VOICED,    MoA::APPROXIMANT, PoA::LABIAL)},
-    {IPA::l,  Phone(IPA::l,  CV::VOICED,    MoA::APPROXIMANT, PoA::ALVEOLAR)},
-    {IPA::ɹ,  Phone(IPA::ɹ,  CV::VOICED,    MoA::APPROXIMANT, PoA::POST_ALVEOLAR)},
-    {IPA::ɥ,  Phone(IPA::ɥ,  CV::VOICED,    MoA::APPROXIMANT, PoA::PALATAL)},
-    {IPA::ʁ̞,  Phone(IPA::ʁ̞,  CV::VOICED,    MoA::APPROXIMANT, PoA::UVULAR)},
-    {IPA::j,  Phone(IPA::j,  CV::VOICED,    MoA::APPROXIMANT, PoA::PALATAL)},
-    // clang-format on
-};
-
 // Private functions
 
 // Public functions
 
+SpellingTable::SpellingTable(ImageReader& image) {
+  first = image.read<uint16_t>();
+  char_offsets = image.read<uint32_t>();
+  chars = image.read<char>();
+  weights = image.read<double>();
+  indices = image.read<uint8_t>();
+  offsets = image.read<uint16_t>();
+  auto threshold = image.read<uint32_t>();
+  samplers = AliasTables(threshold, image.read<uint16_t>());
+}
+
+void SpellingTable::write(const std::vector<std::vector<Spelling>>& inventory,
+                          ImageWriter& image) {
+  std::vector<uint16_t> first = {0};
+  std::vector<uint32_t> char_offsets = {0};
+  std::vector<char> chars;
+  std::vector<double> weights;
+  std::vector<uint8_t> indices;
+  std::vector<uint16_t> offsets = {0};
+  AliasTablesBuilder samplers;
+  std::vector<double> context_weights;
+  for (const auto& spellings : inventory) {
+    for (const Spelling& s : spellings) {
+      chars.insert(chars.end(), s.spelling.begin(), s.spelling.end());
+      char_offsets.push_back(chars.size());
+      weights.push_back(s.weight);
+    }
+    assert(weights.size() <= UINT16_MAX);
+    first.push_back(weights.size());
+    for (uint8_t c = 0; c < kNumContexts; ++c) {
+      context_weights.clear();
+      for (std::size_t i = 0; i < spellings.size(); ++i) {
+        if (spellings[i].rule.allows(Context::from_index(c))) {
+          indices.push_back(i);
+          context_weights.push_back(spellings[i].weight);
+        }
+      }
+      assert(indices.size() <= UINT16_MAX);
+      offsets.push_back(indices.size());
+      samplers.add(context_weights);
+    }
+  }
+  image.write(first);
+  image.write(char_offsets);
+  image.write(chars);
+  image.write(weights);
+  image.write(indices);
+  image.write(offsets);
+  image.write(samplers.threshold);
+  image.write(samplers.alias);
+}
+
+bool SpellingTable::valid(std::size_t num_phonemes) const {
+  if (first.size() != num_phonemes + 1 || first.front() != 0 ||
+      !std::ranges::is_sorted(first) || first.back() != weights.size() ||
+      char_offsets.size() != weights.size() + 1 || char_offsets.front() != 0 ||
+      !std::ranges::is_sorted(char_offsets) || char_offsets.back() != chars.size() ||
+      offsets.size() != num_phonemes * kNumContexts + 1 || offsets.front() != 0 ||
+      !std::ranges::is_sorted(offsets) || offsets.back() != indices.size() ||
+      samplers.size() != indices.size()) {
+    return false;
+  }
+  for (std::size_t p = 0; p < num_phonemes; ++p) {
+    if (num_spellings(p) > 64) {
+      return false;
+    }
+    for (uint8_t c = 0; c < kNumContexts; ++c) {
+      std::size_t i = p * kNumContexts + c;
+      if (!samplers.valid(offsets[i], offsets[i + 1] - offsets[i])) {
+        return false;
+      }
+      for (uint8_t s : get(p, Context::from_index(c))) {
+        if (s >= num_spellings(p)) {
+          return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+ClusterTable::ClusterTable(ImageReader& image) {
+  indices = image.read<uint8_t>();
+  cluster_offsets = image.read<uint16_t>();
+  group_offsets = image.read<uint16_t>();
+  auto threshold = image.read<uint32_t>();
+  samplers = AliasTables(threshold, image.read<uint16_t>());
+}
+
+void ClusterTable::write(const std::vector<std::vector<Cluster>>& groups,
+                         const Phoneme* inventory, const Weight& weight, ImageWriter& image) {
+  std::vector<uint8_t> indices;
+  std::vector<uint16_t> cluster_offsets = {0};
+  std::vector<uint16_t> group_offsets = {0};
+  AliasTablesBuilder samplers;
+  std::vector<double> all_weights;
+  for (const auto& group : groups) {
+    std::vector<double> group_weights;
+    for (const auto& cluster : group) {
+      for (const Phoneme* p : cluster) {
+        assert(p - inventory <= UINT8_MAX);
+        indices.push_back(p - inventory);
+      }
+      assert(indices.size() <= UINT16_MAX);
+      cluster_offsets.push_back(indices.size());
+      group_weights.push_back(weight(cluster));
+    }
+    group_offsets.push_back(cluster_offsets.size() - 1);
+    samplers.add(group_weights);
+    all_weights.insert(all_weights.end(), group_weights.begin(), group_weights.end());
+  }
+  samplers.add(all_weights);
+  image.write(indices);
+  image.write(cluster_offsets);
+  image.write(group_offsets);
+  image.write(samplers.threshold);
+  image.write(samplers.alias);
+}
+
+bool ClusterTable::valid(std::size_t num_phonemes) const {
+  if (cluster_offsets.size() < 2 || cluster_offsets.front() != 0 ||
+      cluster_offsets.back() != indices.size() || group_offsets.size() < 2 ||
+      group_offsets.front() != 0 || group_offsets.back() != num_clusters() ||
+      samplers.size() != 2 * num_clusters() || !samplers.valid(num_clusters(), num_clusters())) {
+    return false;
+  }
+  for (std::size_t c = 0; c < num_clusters(); ++c) {
+    std::size_t size = cluster_offsets[c + 1] - cluster_offsets[c];
+    if (cluster_offsets[c + 1] < cluster_offsets[c] || size < 1 || size > kMaxClusterSize) {
+      return false;
+    }
+  }
+  for (std::size_t g = 0; g < num_groups(); ++g) {
+    if (group_offsets[g + 1] <= group_offsets[g] ||
+        !samplers.valid(group_offsets[g], group_size(g))) {
+      return false;
+    }
+  }
+  return std::ranges::all_of(indices, [&](uint8_t p) { return p < num_phonemes; });
+}
+
 bool homorganic(const Phone* lhs, const Phone* rhs) {
   if (lhs->poa == rhs->poa) {
     return true;
@@ -73,6 +159,4 @@ bool homorganic(const Phone* lhs, const Phone* rhs) {
          (lhs->poa == PoA::POST_ALVEOLAR && rhs->poa == PoA::ALVEOLAR);
 }
 
-Phone get_phone(IPA symbol) { return phones.at(symbol); }
-
 }  // namespace phonology
@@ -1,15 +1,28 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
+#include <bit>
+#include <bitset>
 #include <cassert>
+#include <cstddef>
 #include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <functional>
+#include <initializer_list>
+#include <iterator>
 #include <ranges>
+#include <span>
 #include <string>
-#include <unordered_map>
-#include <unordered_set>
+#include <string_view>
 #include <vector>
 
+#include "image.hpp"
+#include "inplace_vector.hpp"
+#include "random.hpp"
+
 namespace phonology {
 
 enum class IPA : uint8_t {
@@ -65,6 +78,13 @@ enum class IPA : uint8_t {
   j
 };
 
+// The transcription of each symbol in UTF-8, indexed by IPA. The identifiers above use ASCII g
+// where the IPA letter is ɡ.
+inline constexpr std::string_view kIpaSymbols[] = {
+    "ɑ", "ɑ̃", "æ", "a", "aɪ", "aʊ", "ɛ", "ɛ̃", "œ", "e", "eɪ", "ø", "ɪ", "i", "y", "o", "oʊ", "ɔ",
+    "ɔ̃", "ɔɪ", "ʊ", "ə", "u", "m", "n", "ɲ", "ŋ", "p", "t", "tʃ", "k", "b", "d", "dʒ", "ɡ", "f",
+    "θ", "s", "ʃ", "h", "v", "ð", "z", "ʒ", "w", "l", "ɹ", "ɥ", "ʁ̞", "j"};
+
 enum class VowelRoundedness : uint8_t {
   UNROUNDED,
   ROUNDED,
@@ -155,6 +175,277 @@ struct Phone {
       : symbol(symbol), vowel(false), voicing(voicing), moa(moa), poa(poa) {}
 };
 
+// Every phone, indexed by its IPA symbol
+inline constexpr Phone kPhones[] = {
+    // clang-format off
+    Phone(IPA::ɑ,  VR::UNROUNDED, VH::OPEN,         VB::BACK,    VN::ORAL),
+    Phone(IPA::ɑ̃,  VR::UNROUNDED, VH::OPEN,         VB::BACK,    VN::NASAL),
+    Phone(IPA::æ,  VR::UNROUNDED, VH::NEAR_OPEN,    VB::FRONT,   VN::ORAL),
+    Phone(IPA::a,  VR::UNROUNDED, VH::OPEN,         VB::FRONT,   VN::ORAL),
+    Phone(IPA::aɪ, VR::UNROUNDED, VH::OPEN,         VB::FRONT,   VN::ORAL),
+    Phone(IPA::aʊ, VR::UNROUNDED, VH::OPEN,         VB::FRONT,   VN::ORAL),
+    Phone(IPA::ɛ,  VR::UNROUNDED, VH::OPEN_MID,     VB::FRONT,   VN::ORAL),
+    Phone(IPA::ɛ̃,  VR::UNROUNDED, VH::OPEN_MID,     VB::FRONT,   VN::NASAL),
+    Phone(IPA::œ,  VR::ROUNDED,   VH::OPEN_MID,     VB::FRONT,   VN::ORAL),
+    Phone(IPA::e,  VR::UNROUNDED, VH::CLOSE_MID,    VB::FRONT,   VN::ORAL),
+    Phone(IPA::eɪ, VR::UNROUNDED, VH::CLOSE_MID,    VB::FRONT,   VN::ORAL),
+    Phone(IPA::ø,  VR::ROUNDED,   VH::CLOSE_MID,    VB::FRONT,   VN::ORAL),
+    Phone(IPA::ɪ,  VR::UNROUNDED, VH::NEAR_CLOSE,   VB::FRONT,   VN::ORAL),
+    Phone(IPA::i,  VR::UNROUNDED, VH::CLOSE,        VB::FRONT,   VN::ORAL),
+    Phone(IPA::y,  VR::ROUNDED,   VH::CLOSE,        VB::FRONT,   VN::ORAL),
+    Phone(IPA::o,  VR::ROUNDED,   VH::CLOSE_MID,    VB::BACK,    VN::ORAL),
+    Phone(IPA::oʊ, VR::ROUNDED,   VH::CLOSE_MID,    VB::BACK,    VN::ORAL),
+    Phone(IPA::ɔ,  VR::ROUNDED,   VH::OPEN_MID,     VB::BACK,    VN::ORAL),
+    Phone(IPA::ɔ̃,  VR::ROUNDED,   VH::OPEN_MID,     VB::BACK,    VN::NASAL),
+    Phone(IPA::ɔɪ, VR::ROUNDED,   VH::OPEN_MID,     VB::BACK,    VN::ORAL),
+    Phone(IPA::ʊ,  VR::ROUNDED,   VH::NEAR_CLOSE,   VB::BACK,    VN::ORAL),
+    Phone(IPA::ə,  VR::UNROUNDED, VH::MID,          VB::CENTRAL, VN::ORAL),
+    Phone(IPA::u,  VR::ROUNDED,   VH::CLOSE,        VB::BACK,    VN::ORAL),
+    Phone(IPA::m,  CV::VOICED,    MoA::NASAL,       PoA::LABIAL),
+    Phone(IPA::n,  CV::VOICED,    MoA::NASAL,       PoA::ALVEOLAR),
+    Phone(IPA::ɲ,  CV::VOICED,    MoA::NASAL,       PoA::PALATAL),
+    Phone(IPA::ŋ,  CV::VOICED,    MoA::NASAL,       PoA::VELAR),
+    Phone(IPA::p,  CV::VOICELESS, MoA::PLOSIVE,     PoA::LABIAL),
+    Phone(IPA::t,  CV::VOICELESS, MoA::PLOSIVE,     PoA::ALVEOLAR),
+    Phone(IPA::tʃ, CV::VOICELESS, MoA::AFFRICATE,   PoA::POST_ALVEOLAR),
+    Phone(IPA::k,  CV::VOICELESS, MoA::PLOSIVE,     PoA::VELAR),
+    Phone(IPA::b,  CV::VOICED,    MoA::PLOSIVE,     PoA::LABIAL),
+    Phone(IPA::d,  CV::VOICED,    MoA::PLOSIVE,     PoA::ALVEOLAR),
+    Phone(IPA::dʒ, CV::VOICED,    MoA::AFFRICATE,   PoA::POST_ALVEOLAR),
+    Phone(IPA::g,  CV::VOICED,    MoA::PLOSIVE,     PoA::VELAR),
+    Phone(IPA::f,  CV::VOICELESS, MoA::FRICATIVE,   PoA::LABIAL),
+    Phone(IPA::θ,  CV::VOICELESS, MoA::FRICATIVE,   PoA::DENTAL),
+    Phone(IPA::s,  CV::VOICELESS, MoA::FRICATIVE,   PoA::ALVEOLAR),
+    Phone(IPA::ʃ,  CV::VOICELESS, MoA::FRICATIVE,   PoA::POST_ALVEOLAR),
+    Phone(IPA::h,  CV::VOICELESS, MoA::FRICATIVE,   PoA::GLOTTAL),
+    Phone(IPA::v,  CV::VOICED,    MoA::FRICATIVE,   PoA::LABIAL),
+    Phone(IPA::ð,  CV::VOICED,    MoA::FRICATIVE,   PoA::DENTAL),
+    Phone(IPA::z,  CV::VOICED,    MoA::FRICATIVE,   PoA::ALVEOLAR),
+    Phone(IPA::ʒ,  CV::VOICED,    MoA::FRICATIVE,   PoA::POST_ALVEOLAR),
+    Phone(IPA::w,  CV::VOICED,    MoA::APPROXIMANT, PoA::LABIAL),
+    Phone(IPA::l,  CV::VOICED,    MoA::APPROXIMANT, PoA::ALVEOLAR),
+    Phone(IPA::ɹ,  CV::VOICED,    MoA::APPROXIMANT, PoA::POST_ALVEOLAR),
+    Phone(IPA::ɥ,  CV::VOICED,    MoA::APPROXIMANT, PoA::PALATAL),
+    Phone(IPA::ʁ̞,  CV::VOICED,    MoA::APPROXIMANT, PoA::UVULAR),
+    Phone(IPA::j,  CV::VOICED,    MoA::APPROXIMANT, PoA::PALATAL),
+    // clang-format on
+};
+
+constexpr Phone get_phone(IPA symbol) {
+  assert(kPhones[static_cast<std::size_t>(symbol)].symbol == symbol);
+  return kPhones[static_cast<std::size_t>(symbol)];
+}
+static_assert(std::size(kIpaSymbols) == std::size(kPhones));
+static_assert([] {
+  for (std::size_t i = 0; i < std::size(kPhones); ++i) {
+    if (kPhones[i].symbol != static_cast<IPA>(i)) {
+      return false;
+    }
+  }
+  return true;
+}());
+
+struct Phoneme;
+
+// A set of phones, one bit per IPA symbol. Natural classes are precomputed masks, so a query
+// such as "voiceless stops other than /p/" is a couple of bitwise operations over every phone at
+// once. A set is also a predicate, so it can filter a phoneme inventory directly.
+struct PhoneSet {
+  static_assert(std::size(kPhones) <= 64);
+  static constexpr uint64_t kAll = (uint64_t{1} << std::size(kPhones)) - 1;
+
+  uint64_t bits = 0;
+
+  constexpr PhoneSet() = default;
+  constexpr explicit PhoneSet(uint64_t bits) : bits(bits & kAll) {}
+  constexpr PhoneSet(std::initializer_list<IPA> symbols) {
+    for (IPA symbol : symbols) {
+      bits |= bit(symbol);
+    }
+  }
+
+  template <class Predicate>
+  static constexpr PhoneSet where(Predicate predicate) {
+    PhoneSet set;
+    for (const Phone& p : kPhones) {
+      if (predicate(p)) {
+        set.bits |= bit(p.symbol);
+      }
+    }
+    return set;
+  }
+  // The phones with a given feature. Vowel features only match vowels, consonant features only
+  // consonants.
+  static constexpr PhoneSet with(VR f) {
+    return where([=](const Phone& p) { return p.vowel && p.rounded == f; });
+  }
+  static constexpr PhoneSet with(VH f) {
+    return where([=](const Phone& p) { return p.vowel && p.height == f; });
+  }
+  static constexpr PhoneSet with(VB f) {
+    return where([=](const Phone& p) { return p.vowel && p.backness == f; });
+  }
+  static constexpr PhoneSet with(VN f) {
+    return where([=](const Phone& p) { return p.vowel && p.nasality == f; });
+  }
+  static constexpr PhoneSet with(CV f) {
+    return where([=](const Phone& p) { return !p.vowel && p.voicing == f; });
+  }
+  static constexpr PhoneSet with(MoA f) {
+    return where([=](const Phone& p) { return !p.vowel && p.moa == f; });
+  }
+  static constexpr PhoneSet with(PoA f) {
+    return where([=](const Phone& p) { return !p.vowel && p.poa == f; });
+  }
+
+  constexpr bool contains(IPA symbol) const { return bits & bit(symbol); }
+  constexpr bool operator()(const Phone& p) const { return contains(p.symbol); }
+  constexpr bool operator()(const Phoneme& p) const;
+  constexpr std::size_t size() const { return std::popcount(bits); }
+  constexpr bool empty() const { return !bits; }
+
+  friend constexpr PhoneSet operator&(PhoneSet a, PhoneSet b) { return PhoneSet(a.bits & b.bits); }
+  friend constexpr PhoneSet operator|(PhoneSet a, PhoneSet b) { return PhoneSet(a.bits | b.bits); }
+  friend constexpr PhoneSet operator~(PhoneSet a) { return PhoneSet(~a.bits); }
+  friend constexpr bool operator==(PhoneSet a, PhoneSet b) = default;
+
+ private:
+  static constexpr uint64_t bit(IPA symbol) { return uint64_t{1} << static_cast<int>(symbol); }
+};
+
+// Spelling rules only care about a few features of the phones around the one being spelled, so
+// every position falls into one of kNumContexts context classes
+enum class PrevClass : uint8_t {
+  NONE,
+  CONSONANT,
+  W,
+  J,
+  ɥ,
+  FRONT_VOWEL,
+  VOWEL,
+};
+
+enum class NextClass : uint8_t {
+  CONSONANT,
+  I_OR_E,
+  VOWEL,
+  SYLLABLE_END,
+  WORD_END,
+};
+
+struct Context {
+  PrevClass prev;
+  NextClass next;
+
+  static constexpr std::size_t kNumNext = 5;
+
+  constexpr uint8_t index() const {
+    return static_cast<uint8_t>(prev) * kNumNext + static_cast<uint8_t>(next);
+  }
+  static constexpr Context from_index(uint8_t i) {
+    return {static_cast<PrevClass>(i / kNumNext), static_cast<NextClass>(i % kNumNext)};
+  }
+
+  static constexpr PrevClass prev_class(const Phone* prev) {
+    if (!prev) {
+      return PrevClass::NONE;
+    } else if (prev->symbol == IPA::w) {
+      return PrevClass::W;
+    } else if (prev->symbol == IPA::j) {
+      return PrevClass::J;
+    } else if (prev->symbol == IPA::ɥ) {
+      return PrevClass::ɥ;
+    } else if (prev->vowel) {
+      return prev->backness == VB::FRONT ? PrevClass::FRONT_VOWEL : PrevClass::VOWEL;
+    }
+    return PrevClass::CONSONANT;
+  }
+
+  static constexpr NextClass next_class(const Phone* next, bool word_final) {
+    if (!next) {
+      return word_final ? NextClass::WORD_END : NextClass::SYLLABLE_END;
+    } else if (next->vowel) {
+      bool i_or_e = next->rounded == VR::UNROUNDED &&
+                    (next->height == VH::CLOSE || next->height == VH::CLOSE_MID ||
+                     next->height == VH::MID || next->height == VH::OPEN_MID);
+      return i_or_e ? NextClass::I_OR_E : NextClass::VOWEL;
+    }
+    return NextClass::CONSONANT;
+  }
+
+  static constexpr Context of(const Phone* prev, const Phone* next, bool word_final) {
+    return {prev_class(prev), next_class(next, word_final)};
+  }
+
+  constexpr bool after_vowel() const {
+    return prev == PrevClass::FRONT_VOWEL || prev == PrevClass::VOWEL;
+  }
+  constexpr bool before_vowel() const {
+    return next == NextClass::I_OR_E || next == NextClass::VOWEL;
+  }
+  constexpr bool syllable_end() const {
+    return next == NextClass::SYLLABLE_END || next == NextClass::WORD_END;
+  }
+};
+
+constexpr std::size_t kNumContexts = 7 * Context::kNumNext;
+
+// The set of contexts a spelling may be used in, one bit per context class
+struct Rule {
+  uint64_t contexts;
+
+  static constexpr uint64_t kAll = (uint64_t{1} << kNumContexts) - 1;
+
+  template <class Pred>
+  static constexpr Rule where(Pred pred) {
+    uint64_t contexts = 0;
+    for (uint8_t i = 0; i < kNumContexts; ++i) {
+      if (pred(Context::from_index(i))) {
+        contexts |= uint64_t{1} << i;
+      }
+    }
+    return {contexts};
+  }
+  static constexpr Rule after(PrevClass prev) {
+    return where([prev](Context c) { return c.prev == prev; });
+  }
+  static constexpr Rule before(NextClass next) {
+    return where([next](Context c) { return c.next == next; });
+  }
+
+  constexpr bool allows(Context c) const { return contexts & (uint64_t{1} << c.index()); }
+
+  constexpr Rule operator&(Rule rhs) const { return {contexts & rhs.contexts}; }
+  constexpr Rule operator|(Rule rhs) const { return {contexts | rhs.contexts}; }
+  constexpr Rule operator~() const { return {~contexts & kAll}; }
+};
+
+// clang-format off
+inline constexpr Rule any_position      = {Rule::kAll};
+inline constexpr Rule word_final        = Rule::before(NextClass::WORD_END);
+inline constexpr Rule not_word_final    = ~word_final;
+inline constexpr Rule word_initial      = Rule::after(PrevClass::NONE);
+inline constexpr Rule not_word_initial  = ~word_initial;
+inline constexpr Rule is_onset          = word_initial;
+inline constexpr Rule is_coda           = Rule::where([](Context c) { return c.syllable_end(); });
+inline constexpr Rule before_vowel      = Rule::where([](Context c) { return c.before_vowel(); });
+inline constexpr Rule before_i_or_e     = Rule::before(NextClass::I_OR_E);
+inline constexpr Rule not_before_i_or_e = ~before_i_or_e;
+inline constexpr Rule after_vowel       = Rule::where([](Context c) { return c.after_vowel(); });
+inline constexpr Rule after_front_vowel = Rule::after(PrevClass::FRONT_VOWEL);
+inline constexpr Rule after_w           = Rule::after(PrevClass::W);
+inline constexpr Rule after_j           = Rule::after(PrevClass::J);
+inline constexpr Rule after_ɥ           = Rule::after(PrevClass::ɥ);
+inline constexpr Rule not_in_cluster    = Rule::where([](Context c) {
+  return (c.prev == PrevClass::NONE || c.after_vowel()) && (c.syllable_end() || c.before_vowel());
+});
+inline constexpr Rule in_cluster        = ~not_in_cluster;
+inline constexpr Rule between_vowels    = Rule::where([](Context c) {
+  return c.after_vowel() && c.next == NextClass::SYLLABLE_END;
+});
+inline constexpr Rule mid_word          = not_word_initial & not_word_final;
+// clang-format on
+
 struct Spelling {
   struct RuleParams {
     const Phone* prev;
@@ -162,173 +453,957 @@ struct Spelling {
     bool word_final;
   };
 
-  using SpellingRule = std::function<bool(RuleParams)>;
   const std::string spelling;
-  const SpellingRule rule;
+  const Rule rule;
+  // Relative to the other spellings admissible in the same context
+  const double weight;
   Spelling() = delete;
-  Spelling(std::string&& spelling, SpellingRule&& rule) : spelling(spelling), rule(rule) {}
+  Spelling(std::string&& spelling, Rule rule, double weight = 1)
+      : spelling(spelling), rule(rule), weight(weight) {}
 };
 
+// A phoneme of an inventory. Its spellings are only in the spelling table, so that a loaded
+// system views its inventory in the image, as it does its tables.
 struct Phoneme {
   const Phone p;
-  const std::vector<Spelling> spellings;
+};
 
-  Phoneme(Phone&& phone, std::vector<Spelling>&& spellings) : p(phone), spellings(spellings) {}
+constexpr bool PhoneSet::operator()(const Phoneme& p) const { return contains(p.p.symbol); }
 
-  std::string GetSpelling(Spelling::RuleParams p) const {
-    std::size_t i = rand() % spellings.size();
-    while (!spellings[i].rule(p)) {
-      i = (i + 1) % spellings.size();
+// Longest onset or coda any system may produce, e.g. English /spl/
+constexpr std::size_t kMaxClusterSize = 3;
+using Cluster = InplaceVector<const Phoneme*, kMaxClusterSize>;
+
+struct Syllable {
+  Cluster onset;
+  const Phoneme* nucleus;
+  Cluster coda;
+};
+
+// Where the clusters of a drawn syllable came from, as indices into the onset and coda tables
+struct SyllableOrigin {
+  static constexpr std::size_t kNoCoda = SIZE_MAX;
+
+  std::size_t onset;
+  // kNoCoda for no coda
+  std::size_t coda;
+};
+
+// A range of lengths in letters, of a spelling or of what remains of a word. Empty when nothing
+// fits, as for a phoneme none of whose spellings can be used.
+struct Lengths {
+  std::size_t min = SIZE_MAX;
+  std::size_t max = 0;
+
+  constexpr bool empty() const { return min > max; }
+
+  // One thing followed by another
+  friend constexpr Lengths operator+(Lengths a, Lengths b) {
+    return a.empty() || b.empty() ? Lengths{} : Lengths{a.min + b.min, a.max + b.max};
+  }
+  // n things in a row
+  friend constexpr Lengths operator*(Lengths a, std::size_t n) {
+    return !n ? Lengths{0, 0} : a.empty() ? Lengths{} : Lengths{a.min * n, a.max * n};
+  }
+  // Either one thing or another
+  friend constexpr Lengths operator|(Lengths a, Lengths b) {
+    return {std::min(a.min, b.min), std::max(a.max, b.max)};
+  }
+};
+
+// What the words drawn by a Constrained system must look like
+struct Constraints {
+  std::size_t min_length = 0;
+  std::size_t max_length = SIZE_MAX;
+  std::string prefix{};
+  std::string suffix{};
+  // Bytes words may be made of, or any byte if empty
+  std::string alphabet{};
+};
+
+// A word being drawn under Constraints. get_spelling hands it to spell(), which then only picks
+// spellings that can still lead to a word meeting them, and marks the draft failed once some
+// phoneme has none.
+struct Draft {
+  const Constraints* constraints;
+  const std::bitset<256>* alphabet;
+  // Where the word starts in the output
+  std::size_t start;
+  // For each phoneme of the syllable being spelled, in spelling order, the letters that can still
+  // follow it in the word
+  InplaceVector<Lengths, 2 * kMaxClusterSize + 1> rest{};
+  std::size_t position = 0;
+  bool failed = false;
+
+  // Whether a word continuing out with spelling, then with rest more letters, can meet the
+  // constraints
+  bool admits(const std::string& out, std::string_view spelling, Lengths rest) const {
+    const std::size_t at = out.size() - start;
+    const std::size_t length = at + spelling.size();
+    if (length + rest.min > constraints->max_length ||
+        length + rest.max < constraints->min_length) {
+      return false;
+    }
+    const std::string& prefix = constraints->prefix;
+    for (std::size_t i = 0; i < spelling.size(); ++i) {
+      if (!(*alphabet)[static_cast<unsigned char>(spelling[i])] ||
+          (at + i < prefix.size() && prefix[at + i] != spelling[i])) {
+        return false;
+      }
     }
-    return spellings[i].spelling;
+    // Nothing can follow, so the word must end in the suffix now
+    const std::string& suffix = constraints->suffix;
+    if (rest.max == 0 && !suffix.empty()) {
+      if (length < suffix.size()) {
+        return false;
+      }
+      for (std::size_t i = length - suffix.size(), j = 0; i < length; ++i, ++j) {
+        char c = i < at ? out[start + i] : spelling[i - at];
+        if (c != suffix[j]) {
+          return false;
+        }
+      }
+    }
+    return true;
   }
 };
 
-struct Syllable {
-  std::vector<const Phoneme*> onset;
-  const Phoneme* nucleus;
-  std::vector<const Phoneme*> coda;
+// Read-only, packed form of a table of cluster groups. The phonemes of every cluster are stored
+// back to back as 1-byte indices into the system's phoneme inventory, delimited by one offset
+// table for clusters and one for groups. The table views arrays of a phonology image.
+class ClusterTable {
+ public:
+  using Weight = std::function<double(const Cluster&)>;
+
+  ClusterTable() = default;
+  // Views the table written next in the image
+  explicit ClusterTable(ImageReader& image);
+  // Packs groups of clusters, weighted within their group and within the whole table
+  static void write(const std::vector<std::vector<Cluster>>& groups, const Phoneme* inventory,
+                    const Weight& weight, ImageWriter& image);
+  // Whether every offset stays within the table, every group and cluster is non-empty and every
+  // index is within an inventory of num_phonemes
+  bool valid(std::size_t num_phonemes) const;
+
+  std::size_t num_groups() const { return group_offsets.size() - 1; }
+  std::size_t group_size(std::size_t group) const {
+    return group_offsets[group + 1] - group_offsets[group];
+  }
+  std::size_t num_clusters() const { return cluster_offsets.size() - 1; }
+  std::size_t group_offset(std::size_t group) const { return group_offsets[group]; }
+  std::size_t group_of(std::size_t cluster) const {
+    return std::ranges::upper_bound(group_offsets, cluster) - group_offsets.begin() - 1;
+  }
+
+  // A cluster, as indices into the phoneme inventory
+  std::span<const uint8_t> get(std::size_t cluster) const {
+    return indices.subspan(cluster_offsets[cluster],
+                           cluster_offsets[cluster + 1] - cluster_offsets[cluster]);
+  }
+
+  // Weighted draws of a cluster index, from the whole table or from one group
+  std::size_t sample(Rng& rng) const {
+    return samplers.sample(num_clusters(), num_clusters(), rng);
+  }
+  std::size_t sample(std::size_t group, Rng& rng) const {
+    return group_offsets[group] + samplers.sample(group_offsets[group], group_size(group), rng);
+  }
+  // The probabilities behind those draws, indexed by cluster within the table or the group
+  std::vector<double> probabilities() const {
+    return samplers.probabilities(num_clusters(), num_clusters());
+  }
+  std::vector<double> probabilities(std::size_t group) const {
+    return samplers.probabilities(group_offsets[group], group_size(group));
+  }
+
+ private:
+  std::span<const uint8_t> indices;
+  std::span<const uint16_t> cluster_offsets;
+  std::span<const uint16_t> group_offsets;
+  // One distribution per group, at the same offsets as the clusters, then one over all clusters
+  AliasTables samplers;
 };
 
+// The spellings of every phoneme of an inventory, and for every phoneme and context class the
+// list of spellings whose rule allows that context, so that picking a spelling is a single
+// weighted draw. The table views arrays of a phonology image.
+class SpellingTable {
+ public:
+  SpellingTable() = default;
+  // Views the table written next in the image
+  explicit SpellingTable(ImageReader& image);
+  // Packs the spellings of each phoneme of an inventory, in order
+  static void write(const std::vector<std::vector<Spelling>>& inventory, ImageWriter& image);
+  // Whether every offset and index stays within the table and an inventory of num_phonemes
+  bool valid(std::size_t num_phonemes) const;
+
+  std::size_t num_spellings(std::size_t phoneme) const {
+    return first[phoneme + 1] - first[phoneme];
+  }
+  std::string_view spelling(std::size_t phoneme, std::size_t i) const {
+    std::size_t s = first[phoneme] + i;
+    return {chars.data() + char_offsets[s], char_offsets[s + 1] - char_offsets[s]};
+  }
+  double weight(std::size_t phoneme, std::size_t i) const { return weights[first[phoneme] + i]; }
+
+  // The admissible spellings, as indices among the phoneme's spellings
+  std::span<const uint8_t> get(std::size_t phoneme, Context c) const {
+    std::size_t i = phoneme * kNumContexts + c.index();
+    return indices.subspan(offsets[i], offsets[i + 1] - offsets[i]);
+  }
+
+  // Weighted draw of an admissible spelling index
+  uint8_t sample(std::size_t phoneme, Context c, Rng& rng) const {
+    std::size_t i = phoneme * kNumContexts + c.index();
+    return indices[offsets[i] + samplers.sample(offsets[i], offsets[i + 1] - offsets[i], rng)];
+  }
+  // The probabilities behind that draw, parallel to get(phoneme, c)
+  std::vector<double> probabilities(std::size_t phoneme, Context c) const {
+    std::size_t i = phoneme * kNumContexts + c.index();
+    return samplers.probabilities(offsets[i], offsets[i + 1] - offsets[i]);
+  }
+
+ private:
+  // The spellings of phoneme p are first[p] to first[p + 1] - 1, their letters back to back
+  std::span<const uint16_t> first;
+  std::span<const uint32_t> char_offsets;
+  std::span<const char> chars;
+  std::span<const double> weights;
+  // Admissible spellings, one list per phoneme and context
+  std::span<const uint8_t> indices;
+  std::span<const uint16_t> offsets;
+  AliasTables samplers;
+};
+
+using SpellingVisitor = std::function<void(std::string_view spelling, double probability)>;
+
+template <class T>
+class Constrained;
+
+// A language: its phoneme inventory, spellings and syllable structure. Languages derive from
+// System and describe themselves in init_phonemes, init_onsets, init_nuclei and init_codas, which
+// the constructor then packs into a phonology image; words are drawn from the tables of that
+// image, so a System can equally be loaded from an image saved earlier (see ImageLanguage).
+// Everything a System holds is only read once it is constructed, so one instance can be shared by
+// any number of threads as long as each brings its own Rng.
 template <class T>
 class System {
  public:
-  System() {
+  // Loads the language's built-in image, compiled from its definitions when the generator was
+  // built and linked in as read-only data. It was checked then, so it is used as it is.
+  System() { load(Image::view(T::builtin_image()), false); }
+  System(const System&) = delete;
+  System& operator=(const System&) = delete;
+
+  const Phoneme* get_phoneme(IPA symbol) const {
+    uint8_t i = phoneme_index[static_cast<std::size_t>(symbol)];
+    assert(i != kNoPhoneme);
+    return &phonemes[i];
+  }
+
+  // Writes the image the system was built from, creating or truncating the file at path
+  void save(const char* path) const { image.save(path); }
+
+  // Builds the language from its definitions and packs it into an image, as the build does for
+  // the built-in images. Aborts if the definitions leave a phoneme unspellable somewhere.
+  static Image compile_definitions() {
+    T language{Definitions{}};
+    return std::move(language.image);
+  }
+
+  // Syllable structure is drawn the same way for every language: any onset, then a nucleus from
+  // the group the onset's last phoneme allows, then on a coin flip (always, if the nucleus requires
+  // one) a coda from the group the nucleus allows
+  Cluster get_onset(Rng& rng) const { return get_cluster(onset_table, onset_table.sample(rng)); }
+  const Phoneme* get_nucleus(const Phoneme* onset, Rng& rng) const {
+    return get_cluster(nucleus_table, sample_nucleus(onset, rng)).front();
+  }
+  Cluster get_coda(const Phoneme* nucleus, Rng& rng) const {
+    std::size_t coda = sample_coda(nucleus, rng);
+    return coda == kNoCoda ? Cluster{} : get_cluster(coda_table, coda);
+  }
+
+  // Draws a syllable as get_onset, get_nucleus and get_coda do in turn, noting in origin where
+  // its onset and coda came from
+  Syllable get_syllable(Rng& rng, SyllableOrigin& origin) const {
+    Syllable syllable;
+    origin.onset = onset_table.sample(rng);
+    syllable.onset = get_cluster(onset_table, origin.onset);
+    std::size_t nucleus = sample_nucleus(syllable.onset.back(), rng);
+    syllable.nucleus = get_cluster(nucleus_table, nucleus).front();
+    origin.coda = sample_coda(syllable.nucleus, rng);
+    if (origin.coda != kNoCoda) {
+      syllable.coda = get_cluster(coda_table, origin.coda);
+    }
+    return syllable;
+  }
+  // The group of onsets or codas the language defined that a cluster of the table belongs to
+  std::size_t onset_group_of(std::size_t onset) const { return onset_table.group_of(onset); }
+  std::size_t coda_group_of(std::size_t coda) const { return coda_table.group_of(coda); }
+
+  // Appends the spelling of the syllable to out: each phoneme spelled in the context of its
+  // neighbours, and for a word-final open syllable, half the time, one of the silent letters.
+  // Under a draft, only spellings the draft admits are used; if some phoneme has none, the draft
+  // is marked failed and the syllable left unfinished.
+  void get_spelling(const Syllable& syllable, bool word_final, Rng& rng, std::string& out,
+                    Draft* draft = nullptr) const {
+    Spelling::RuleParams rp;
+    rp.prev = nullptr;
+    rp.word_final = false;
+    for (std::size_t i = 0; i < syllable.onset.size(); ++i) {
+      rp.next = i == syllable.onset.size() - 1 ? &syllable.nucleus->p : &syllable.onset[i + 1]->p;
+      spell(syllable.onset[i], rp, rng, out, draft);
+      rp.prev = &syllable.onset[i]->p;
+    }
+
+    if (syllable.coda.size()) {
+      rp.next = &syllable.coda.front()->p;
+    } else {
+      rp.next = nullptr;
+      rp.word_final = word_final;
+    }
+    spell(syllable.nucleus, rp, rng, out, draft);
+    rp.prev = &syllable.nucleus->p;
+
+    if (word_final && !syllable.coda.size() && !silent_letters.empty()) {
+      if (uniform(rng, 2)) {
+        int i = uniform(rng, silent_letters.size());
+        // Under a draft the letter is left off unless the word can end in it
+        if (!draft ||
+            (!draft->failed && draft->admits(out, silent_letters.substr(i, 1), {0, 0}))) {
+          out += silent_letters[i];
+        }
+      }
+    }
+
+    for (std::size_t i = 0; i < syllable.coda.size(); ++i) {
+      if (i == syllable.coda.size() - 1) {
+        rp.next = nullptr;
+        rp.word_final = word_final;
+      } else {
+        rp.next = &syllable.coda[i + 1]->p;
+      }
+      spell(syllable.coda[i], rp, rng, out, draft);
+      rp.prev = &syllable.coda[i]->p;
+    }
+  }
+
+  // Calls visit once for every way get_onset, get_nucleus, get_coda and get_spelling can produce a
+  // single syllable, with the probability of that way. Different ways can spell the same string.
+  void for_each_syllable(bool word_final, const SpellingVisitor& visit) const {
+    std::vector<double> onset_p = onset_table.probabilities();
+    std::vector<double> coda_p = coda_table.probabilities();
+    for (std::size_t o = 0; o < onset_table.num_clusters(); ++o) {
+      Syllable syllable;
+      syllable.onset = get_cluster(onset_table, o);
+      std::size_t nucleus_g = nucleus_group[index_of(syllable.onset.back())];
+      std::vector<double> nucleus_p = nucleus_table.probabilities(nucleus_g);
+      for (std::size_t n = 0; n < nucleus_p.size(); ++n) {
+        std::size_t cluster = nucleus_table.group_offset(nucleus_g) + n;
+        syllable.nucleus = get_cluster(nucleus_table, cluster).front();
+        double p = onset_p[o] * nucleus_p[n];
+        auto with_p = [&](double q) {
+          return [&visit, q](std::string_view spelling, double r) { visit(spelling, q * r); };
+        };
+        double coda_share = 1;
+        if (!nuclei_requiring_coda[index_of(syllable.nucleus)]) {
+          syllable.coda = {};
+          for_each_spelling(syllable, word_final, with_p(p / 2));
+          coda_share = 0.5;
+        }
+        std::size_t coda_g = coda_group[index_of(syllable.nucleus)];
+        std::size_t first = coda_g == kAnyGroup ? 0 : coda_table.group_offset(coda_g);
+        std::vector<double> group_p =
+            coda_g == kAnyGroup ? coda_p : coda_table.probabilities(coda_g);
+        for (std::size_t c = 0; c < group_p.size(); ++c) {
+          syllable.coda = get_cluster(coda_table, first + c);
+          for_each_spelling(syllable, word_final, with_p(p * coda_share * group_p[c]));
+        }
+      }
+    }
+  }
+
+ protected:
+  template <class>
+  friend class Constrained;
+
+  // Adopts the tables of an image saved from another System
+  explicit System(Image&& image) { load(std::move(image)); }
+
+  // Builds the tables from what the language's init_phonemes, init_onsets, init_nuclei and
+  // init_codas describe. Languages inherit this constructor for compile_definitions.
+  struct Definitions {};
+  explicit System(Definitions) {
+    // Reserved up front, so that the clusters the later init functions build can point into it
+    inventory.reserve(kMaxPhonemes);
     static_cast<T*>(this)->init_phonemes();
+    index_phonemes();
     static_cast<T*>(this)->init_onsets();
     static_cast<T*>(this)->init_nuclei();
     static_cast<T*>(this)->init_codas();
+    load(compile());
+    // The inventory and nested tables are only needed while the language builds them
+    inventory = std::vector<Phoneme>();
+    inventory_spellings = std::vector<std::vector<Spelling>>();
+    onsets = {};
+    nuclei = {};
+    codas = {};
   }
 
-  const Phoneme* get_phoneme(IPA symbol) const {
-    for (const auto& p : phonemes) {
-      if (p.p.symbol == symbol) {
-        return &p;
-      }
+  // Adds a phoneme with its spellings to the inventory, for init_phonemes
+  void add_phoneme(const Phone& phone, std::vector<Spelling>&& spellings) {
+    assert(inventory.size() < kMaxPhonemes && spellings.size() <= 64);
+    inventory.push_back(Phoneme{phone});
+    inventory_spellings.push_back(std::move(spellings));
+    phonemes = inventory;
+  }
+
+  // Relative weights of table entries within their group and within the whole table. Languages
+  // shadow these to make some clusters and nuclei rarer than others.
+  double onset_weight(const Cluster& onset) const { return 1; }
+  double nucleus_weight(const Phoneme* nucleus) const { return 1; }
+  double coda_weight(const Cluster& coda) const { return 1; }
+
+  // Table indices of the clusters get_nucleus and get_coda draw, kNoCoda for no coda
+  static constexpr std::size_t kNoCoda = SyllableOrigin::kNoCoda;
+  std::size_t sample_nucleus(const Phoneme* onset, Rng& rng) const {
+    return nucleus_table.sample(nucleus_group[index_of(onset)], rng);
+  }
+  std::size_t sample_coda(const Phoneme* nucleus, Rng& rng) const {
+    if (uniform(rng, 2) && !nuclei_requiring_coda[index_of(nucleus)]) {
+      return kNoCoda;
     }
-    assert(0);
-    return nullptr;
+    if (std::size_t group = coda_group[index_of(nucleus)]; group != kAnyGroup) {
+      return coda_table.sample(group, rng);
+    }
+    return coda_table.sample(rng);
   }
 
-  // TODO: use inplace_vector or something similar
-  std::vector<const Phoneme*> get_onset() const { return static_cast<const T*>(this)->get_onset(); }
-  const Phoneme* get_nucleus(const Phoneme* onset) const {
-    return static_cast<const T*>(this)->get_nucleus(onset);
+  Cluster get_cluster(const ClusterTable& table, std::size_t cluster) const {
+    Cluster c;
+    for (uint8_t i : table.get(cluster)) {
+      c.push_back(&phonemes[i]);
+    }
+    return c;
   }
-  std::vector<const Phoneme*> get_coda(const Phoneme* nucleus) const {
-    return static_cast<const T*>(this)->get_coda(nucleus);
+
+  // Appends a spelling of p admissible in the context rp describes. Under a draft, the draw is
+  // limited to the spellings the draft admits, still in proportion to their weights.
+  void spell(const Phoneme* p, Spelling::RuleParams rp, Rng& rng, std::string& out,
+             Draft* draft) const {
+    Context c = Context::of(rp.prev, rp.next, rp.word_final);
+    std::size_t phoneme = index_of(p);
+    if (!draft) {
+      out += spelling_table.spelling(phoneme, spelling_table.sample(phoneme, c, rng));
+      return;
+    }
+    if (draft->failed) {
+      return;
+    }
+    Lengths rest = draft->rest[draft->position++];
+    auto choices = spelling_table.get(phoneme, c);
+    uint64_t admissible = 0;
+    double total = 0;
+    for (std::size_t i = 0; i < choices.size(); ++i) {
+      if (draft->admits(out, spelling_table.spelling(phoneme, choices[i]), rest)) {
+        admissible |= uint64_t{1} << i;
+        total += spelling_table.weight(phoneme, choices[i]);
+      }
+    }
+    if (!admissible) {
+      draft->failed = true;
+      return;
+    }
+    if (static_cast<std::size_t>(std::popcount(admissible)) == choices.size()) {
+      out += spelling_table.spelling(phoneme, spelling_table.sample(phoneme, c, rng));
+      return;
+    }
+    double x = uniform_real(rng) * total;
+    for (;;) {
+      std::size_t i = std::countr_zero(admissible);
+      admissible &= admissible - 1;
+      x -= spelling_table.weight(phoneme, choices[i]);
+      if (x < 0 || !admissible) {
+        out += spelling_table.spelling(phoneme, choices[i]);
+        return;
+      }
+    }
   }
 
-  std::string get_spelling(const Syllable& syllable, bool word_final) const {
-    return static_cast<const T*>(this)->get_spelling(syllable, word_final);
+  // Calls visit for every way get_spelling can spell the syllable
+  void for_each_spelling(const Syllable& syllable, bool word_final,
+                         const SpellingVisitor& visit) const {
+    struct Position {
+      const Phoneme* phoneme;
+      Context context;
+    };
+    InplaceVector<Position, 2 * kMaxClusterSize + 1> positions;
+    const Phoneme* prev = nullptr;
+    auto add = [&](const Phoneme* p, const Phoneme* next, bool final) {
+      Context c = Context::of(prev ? &prev->p : nullptr, next ? &next->p : nullptr, final);
+      positions.push_back({p, c});
+      prev = p;
+    };
+    const auto& onset = syllable.onset;
+    const auto& coda = syllable.coda;
+    for (std::size_t i = 0; i < onset.size(); ++i) {
+      add(onset[i], i + 1 < onset.size() ? onset[i + 1] : syllable.nucleus, false);
+    }
+    add(syllable.nucleus, coda.empty() ? nullptr : coda.front(), coda.empty() && word_final);
+    for (std::size_t i = 0; i < coda.size(); ++i) {
+      add(coda[i], i + 1 < coda.size() ? coda[i + 1] : nullptr, i + 1 == coda.size() && word_final);
+    }
+    // Half the time get_spelling appends one of the silent letters
+    bool silent = word_final && coda.empty() && !silent_letters.empty();
+
+    std::string spelling;
+    auto expand = [&](auto& self, std::size_t i, double p) -> void {
+      if (i == positions.size()) {
+        if (!silent) {
+          visit(spelling, p);
+          return;
+        }
+        visit(spelling, p / 2);
+        for (char c : silent_letters) {
+          spelling += c;
+          visit(spelling, p / 2 / silent_letters.size());
+          spelling.pop_back();
+        }
+        return;
+      }
+      std::size_t phoneme = index_of(positions[i].phoneme);
+      auto choices = spelling_table.get(phoneme, positions[i].context);
+      auto choice_p = spelling_table.probabilities(phoneme, positions[i].context);
+      for (std::size_t j = 0; j < choices.size(); ++j) {
+        std::size_t size = spelling.size();
+        spelling += spelling_table.spelling(phoneme, choices[j]);
+        self(self, i + 1, p * choice_p[j]);
+        spelling.resize(size);
+      }
+    };
+    expand(expand, 0, 1);
   }
 
- protected:
-  std::vector<Phoneme> phonemes;
-  std::vector<std::vector<std::vector<const Phoneme*>>> onsets;
+  // The inventory, in the image once loaded
+  std::span<const Phoneme> phonemes;
+  std::vector<Phoneme> inventory;
+  std::vector<std::vector<Spelling>> inventory_spellings;
+  std::vector<std::vector<Cluster>> onsets;
   std::vector<std::vector<const Phoneme*>> nuclei;
-  std::vector<std::vector<std::vector<const Phoneme*>>> codas;
+  std::vector<std::vector<Cluster>> codas;
+  // Letters one of which get_spelling adds to half the words that end in an open syllable, as
+  // French writes silent final consonants. Empty for none.
+  std::string_view silent_letters;
+
+  Image image;
+  ClusterTable onset_table;
+  ClusterTable nucleus_table;
+  ClusterTable coda_table;
+  SpellingTable spelling_table;
+
+  // Per-phoneme tables are indexed by position in phonemes
+  static constexpr std::size_t kMaxPhonemes = std::size(kPhones);
+  static constexpr uint8_t kAnyGroup = UINT8_MAX;
+  std::size_t index_of(const Phoneme* p) const { return p - phonemes.data(); }
+
+  // Nucleus group allowed after the last phoneme of an onset; group 0 unless restricted
+  std::array<uint8_t, kMaxPhonemes> nucleus_group{};
+  // Coda group allowed after a nucleus, or kAnyGroup to draw from the whole table
+  std::array<uint8_t, kMaxPhonemes> coda_group = [] {
+    std::array<uint8_t, kMaxPhonemes> groups;
+    groups.fill(kAnyGroup);
+    return groups;
+  }();
+  std::bitset<kMaxPhonemes> nuclei_requiring_coda;
+
+ private:
+  static constexpr uint8_t kNoPhoneme = UINT8_MAX;
+  std::array<uint8_t, kMaxPhonemes> phoneme_index;
+
+  // Whether the bytes of a phoneme read from an image are those of the phone of its symbol, so
+  // that its fields can be read
+  static bool is_phone(const Phoneme& record) {
+    static_assert(sizeof(Phoneme) == sizeof(Phone) && offsetof(Phone, symbol) == 0);
+    uint8_t symbol;
+    std::memcpy(&symbol, &record, sizeof(symbol));
+    return symbol < std::size(kPhones) && !std::memcmp(&record, &kPhones[symbol], sizeof(Phone));
+  }
+
+  // A symbol listed twice finds its first phoneme, as a scan of the inventory would
+  void index_phonemes() {
+    phoneme_index.fill(kNoPhoneme);
+    for (std::size_t i = phonemes.size(); i-- > 0;) {
+      phoneme_index[static_cast<std::size_t>(phonemes[i].p.symbol)] = i;
+    }
+  }
+
+  // Packs what the language described into an image, in the order load reads it back
+  Image compile() const {
+    const T* self = static_cast<const T*>(this);
+    ImageWriter writer;
+    std::vector<uint8_t> requiring_coda;
+    for (std::size_t i = 0; i < phonemes.size(); ++i) {
+      requiring_coda.push_back(nuclei_requiring_coda[i]);
+    }
+    writer.write(phonemes);
+    writer.write(std::span<const uint8_t>(nucleus_group.data(), phonemes.size()));
+    writer.write(std::span<const uint8_t>(coda_group.data(), phonemes.size()));
+    writer.write(requiring_coda);
+    writer.write(std::span<const char>(silent_letters));
+    SpellingTable::write(inventory_spellings, writer);
+    ClusterTable::write(onsets, phonemes.data(),
+                        [self](const Cluster& c) { return self->onset_weight(c); }, writer);
+    std::vector<std::vector<Cluster>> nucleus_groups;
+    for (const auto& group : nuclei) {
+      nucleus_groups.emplace_back();
+      for (const Phoneme* n : group) {
+        nucleus_groups.back().push_back({n});
+      }
+    }
+    ClusterTable::write(nucleus_groups, phonemes.data(),
+                        [self](const Cluster& c) { return self->nucleus_weight(c.front()); },
+                        writer);
+    ClusterTable::write(codas, phonemes.data(),
+                        [self](const Cluster& c) { return self->coda_weight(c); }, writer);
+    return writer.finish();
+  }
+
+  // Points the inventory and tables into the image. Aborts if the image does not hold a
+  // consistent system. Without check, only the layout and phonemes are checked: built-in images
+  // had their tables checked when compiled.
+  void load(Image&& packed, bool check = true) {
+    image = std::move(packed);
+    ImageReader reader(image);
+    auto records = reader.read<Phoneme>();
+    auto nucleus_groups = reader.read<uint8_t>();
+    auto coda_groups = reader.read<uint8_t>();
+    auto requiring_coda = reader.read<uint8_t>();
+    auto letters = reader.read<char>();
+    spelling_table = SpellingTable(reader);
+    onset_table = ClusterTable(reader);
+    nucleus_table = ClusterTable(reader);
+    coda_table = ClusterTable(reader);
+    silent_letters = std::string_view(letters.data(), letters.size());
+
+    const std::size_t n = records.size();
+    bool valid = reader.complete() && n <= kMaxPhonemes && nucleus_groups.size() == n &&
+                 coda_groups.size() == n && requiring_coda.size() == n &&
+                 std::ranges::all_of(records, is_phone) &&
+                 (!check || (spelling_table.valid(n) && onset_table.valid(n) &&
+                             nucleus_table.valid(n) && coda_table.valid(n)));
+    if (valid) {
+      phonemes = records;
+      index_phonemes();
+    }
+    for (std::size_t i = 0; valid && i < n; ++i) {
+      valid = nucleus_groups[i] < nucleus_table.num_groups() &&
+              (coda_groups[i] == kAnyGroup || coda_groups[i] < coda_table.num_groups());
+      nucleus_group[i] = nucleus_groups[i];
+      coda_group[i] = coda_groups[i];
+      nuclei_requiring_coda[i] = requiring_coda[i];
+    }
+    for (std::size_t i = 0; valid && i < nucleus_table.num_clusters(); ++i) {
+      valid = nucleus_table.get(i).size() == 1;
+    }
+    if (!valid) {
+      std::fprintf(stderr, "phonology: image does not hold a consistent system\n");
+      std::abort();
+    }
+    if (check) {
+      check_spellings();
+    }
+  }
+
+  // Walks the cluster tables to find every context each phoneme can be spelled in, and aborts
+  // if any of them has no admissible spelling. Images are checked too, as a loaded system draws
+  // from these lists without looking at their size.
+  void check_spellings() const {
+    std::vector<uint64_t> reachable(phonemes.size());
+    auto mark = [&](const Phoneme* p, const Phoneme* prev, const Phoneme* next, bool word_final) {
+      Context c = Context::of(prev ? &prev->p : nullptr, next ? &next->p : nullptr, word_final);
+      reachable[p - phonemes.data()] |= uint64_t{1} << c.index();
+    };
+
+    // Onsets, and the classes of phone each nucleus can follow
+    std::vector<uint8_t> nucleus_prev(phonemes.size());
+    for (std::size_t o = 0; o < onset_table.num_clusters(); ++o) {
+      Cluster onset = get_cluster(onset_table, o);
+      for (std::size_t i = 0; i + 1 < onset.size(); ++i) {
+        mark(onset[i], i ? onset[i - 1] : nullptr, onset[i + 1], false);
+      }
+      const Phoneme* last = onset.back();
+      const Phoneme* before_last = onset.size() > 1 ? onset[onset.size() - 2] : nullptr;
+      std::size_t g = nucleus_group[index_of(last)];
+      for (std::size_t i = 0; i < nucleus_table.group_size(g); ++i) {
+        const Phoneme* n = get_cluster(nucleus_table, nucleus_table.group_offset(g) + i).front();
+        mark(last, before_last, n, false);
+        nucleus_prev[n - phonemes.data()] |= 1 << static_cast<int>(Context::prev_class(&last->p));
+      }
+    }
 
-  std::unordered_map<const Phoneme*, std::size_t> nucleus_index_map;
-  std::unordered_map<const Phoneme*, std::size_t> coda_index_map;
+    // Nuclei and codas
+    for (std::size_t n = 0; n < phonemes.size(); ++n) {
+      if (!nucleus_prev[n]) {
+        continue;
+      }
+      const Phoneme* nucleus = &phonemes[n];
+      uint8_t nucleus_next = 0;
+      if (!nuclei_requiring_coda[n]) {
+        nucleus_next |= 1 << static_cast<int>(NextClass::SYLLABLE_END);
+        nucleus_next |= 1 << static_cast<int>(NextClass::WORD_END);
+      }
+      for (std::size_t g = 0; g < coda_table.num_groups(); ++g) {
+        if (coda_group[n] != kAnyGroup && coda_group[n] != g) {
+          continue;
+        }
+        for (std::size_t k = 0; k < coda_table.group_size(g); ++k) {
+          Cluster coda = get_cluster(coda_table, coda_table.group_offset(g) + k);
+          nucleus_next |= 1 << static_cast<int>(Context::next_class(&coda.front()->p, false));
+          for (std::size_t i = 0; i < coda.size(); ++i) {
+            const Phoneme* prev = i ? coda[i - 1] : nucleus;
+            if (i + 1 < coda.size()) {
+              mark(coda[i], prev, coda[i + 1], false);
+            } else {
+              mark(coda[i], prev, nullptr, false);
+              mark(coda[i], prev, nullptr, true);
+            }
+          }
+        }
+      }
+      for (uint8_t c = 0; c < kNumContexts; ++c) {
+        Context context = Context::from_index(c);
+        if ((nucleus_prev[n] >> static_cast<int>(context.prev) & 1) &&
+            (nucleus_next >> static_cast<int>(context.next) & 1)) {
+          reachable[n] |= uint64_t{1} << c;
+        }
+      }
+    }
 
-  std::unordered_set<const Phoneme*> nuclei_requiring_coda;
+    bool complete = true;
+    for (std::size_t p = 0; p < phonemes.size(); ++p) {
+      for (uint8_t c = 0; c < kNumContexts; ++c) {
+        if ((reachable[p] >> c & 1) && spelling_table.get(p, Context::from_index(c)).empty()) {
+          fprintf(stderr, "phonology: phoneme %zu (IPA %d) has no spelling in context %d\n", p,
+                  static_cast<int>(phonemes[p].p.symbol), c);
+          complete = false;
+        }
+      }
+    }
+    if (!complete) {
+      std::abort();
+    }
+  }
 };
 
-using phone_filter = std::function<bool(const Phoneme&)>;
 // clang-format off
-// Defining helper functions
-inline bool consonant  (const Phoneme& p) { return !p.p.vowel; }
-inline bool vowel      (const Phoneme& p) { return p.p.vowel; }
-inline bool rounded    (const Phoneme& p) { return p.p.vowel && p.p.rounded == VR::ROUNDED; }
-inline bool unrounded  (const Phoneme& p) { return p.p.vowel && p.p.rounded == VR::UNROUNDED; }
-inline bool front      (const Phoneme& p) { return p.p.vowel && p.p.backness == VB::FRONT; }
-inline bool mid        (const Phoneme& p) { return p.p.vowel && p.p.height == VH::MID; }
-inline bool nasal_v    (const Phoneme& p) { return p.p.vowel && p.p.nasality == VN::NASAL; }
-inline bool oral_v     (const Phoneme& p) { return p.p.vowel && p.p.nasality == VN::ORAL; }
-inline bool stop       (const Phoneme& p) { return !p.p.vowel && p.p.moa == MoA::PLOSIVE; }
-inline bool approximant(const Phoneme& p) { return !p.p.vowel && p.p.moa == MoA::APPROXIMANT; }
-inline bool fricative  (const Phoneme& p) { return !p.p.vowel && p.p.moa == MoA::FRICATIVE; }
-inline bool affricate  (const Phoneme& p) { return !p.p.vowel && p.p.moa == MoA::AFFRICATE; }
-inline bool nasal_c    (const Phoneme& p) { return !p.p.vowel && p.p.moa == MoA::NASAL; }
-inline bool labial     (const Phoneme& p) { return !p.p.vowel && p.p.poa == PoA::LABIAL; }
-inline bool alveolar   (const Phoneme& p) { return !p.p.vowel && p.p.poa == PoA::ALVEOLAR; }
-inline bool voiced     (const Phoneme& p) { return !p.p.vowel && p.p.voicing == CV::VOICED; }
-inline bool voiceless  (const Phoneme& p) { return !p.p.vowel && p.p.voicing == CV::VOICELESS; }
-inline bool sibilant   (const Phoneme& p) {
-  return (p.p.moa == MoA::FRICATIVE) &&
-         (p.p.poa == PoA::ALVEOLAR || p.p.poa == PoA::POST_ALVEOLAR);
-}
-inline bool any_mid    (const Phoneme& p) {
-  return p.p.vowel &&
-        (p.p.height == VH::CLOSE_MID || p.p.height == VH::MID || p.p.height == VH::OPEN_MID);
-}
+// Natural classes
+inline constexpr PhoneSet vowel       = PhoneSet::where([](const Phone& p) { return p.vowel; });
+inline constexpr PhoneSet consonant   = ~vowel;
+inline constexpr PhoneSet rounded     = PhoneSet::with(VR::ROUNDED);
+inline constexpr PhoneSet unrounded   = PhoneSet::with(VR::UNROUNDED);
+inline constexpr PhoneSet front       = PhoneSet::with(VB::FRONT);
+inline constexpr PhoneSet mid         = PhoneSet::with(VH::MID);
+inline constexpr PhoneSet nasal_v     = PhoneSet::with(VN::NASAL);
+inline constexpr PhoneSet oral_v      = PhoneSet::with(VN::ORAL);
+inline constexpr PhoneSet stop        = PhoneSet::with(MoA::PLOSIVE);
+inline constexpr PhoneSet approximant = PhoneSet::with(MoA::APPROXIMANT);
+inline constexpr PhoneSet fricative   = PhoneSet::with(MoA::FRICATIVE);
+inline constexpr PhoneSet affricate   = PhoneSet::with(MoA::AFFRICATE);
+inline constexpr PhoneSet nasal_c     = PhoneSet::with(MoA::NASAL);
+inline constexpr PhoneSet labial      = PhoneSet::with(PoA::LABIAL);
+inline constexpr PhoneSet alveolar    = PhoneSet::with(PoA::ALVEOLAR);
+inline constexpr PhoneSet voiced      = PhoneSet::with(CV::VOICED);
+inline constexpr PhoneSet voiceless   = PhoneSet::with(CV::VOICELESS);
+inline constexpr PhoneSet sibilant    = fricative & (alveolar | PhoneSet::with(PoA::POST_ALVEOLAR));
+inline constexpr PhoneSet any_mid     = PhoneSet::with(VH::CLOSE_MID) | mid |
+                                        PhoneSet::with(VH::OPEN_MID);
 // clang-format on
 
-inline constexpr phone_filter except(const std::vector<phonology::IPA>& exceptions) {
-  return [exceptions](const auto& p) {
-    return std::find(exceptions.begin(), exceptions.end(), p.p.symbol) == exceptions.end();
-  };
+template <class... Symbols>
+constexpr PhoneSet except(Symbols... exceptions) {
+  return ~PhoneSet{exceptions...};
 }
 
-inline constexpr phone_filter except(const phonology::IPA exception) {
-  return [exception](const auto& p) { return p.p.symbol != exception; };
-}
+bool homorganic(const Phone* lhs, const Phone* rhs);
+
+// What get_word writes besides the spelling: nothing, or a tab and the IPA transcription of the
+// word between slashes, optionally with its syllables separated by periods
+enum class Transcription : uint8_t {
+  NONE,
+  IPA,
+  IPA_SYLLABLES,
+};
+
+// Builds the transcription of a word in the buffer its spelling goes to. The transcription so far
+// is kept after the spelling, and the spelling of each new syllable is rotated in front of it, so
+// neither needs a buffer of its own.
+class Transcript {
+ public:
+  Transcript(const std::string& out, bool boundaries)
+      : spelling_end(out.size()), boundaries(boundaries) {}
 
-inline bool any_position    ([[maybe_unused]] Spelling::RuleParams rp) { return true; }
-inline bool word_final      (Spelling::RuleParams rp) { return rp.word_final; };
-inline bool not_word_final  (Spelling::RuleParams rp) { return !rp.word_final; }
-inline bool is_onset        (Spelling::RuleParams rp) { return rp.prev == nullptr; }
-inline bool is_coda         (Spelling::RuleParams rp) { return rp.next == nullptr; }
-inline bool not_in_cluster  (Spelling::RuleParams rp) {
-  return (rp.prev == nullptr || rp.prev->vowel) && (rp.next == nullptr || rp.next->vowel);
+  // Called once the spelling of syllable has been appended to out
+  void add(const Syllable& syllable, std::string& out) {
+    const std::size_t transcript_end = spelling_end + size;
+    std::rotate(out.begin() + spelling_end, out.begin() + transcript_end, out.end());
+    spelling_end += out.size() - transcript_end;
+    if (boundaries && size) {
+      out += '.';
+    }
+    for (const Phoneme* p : syllable.onset) {
+      out += kIpaSymbols[static_cast<std::size_t>(p->p.symbol)];
+    }
+    out += kIpaSymbols[static_cast<std::size_t>(syllable.nucleus->p.symbol)];
+    for (const Phoneme* p : syllable.coda) {
+      out += kIpaSymbols[static_cast<std::size_t>(p->p.symbol)];
+    }
+    size = out.size() - spelling_end;
+  }
+
+  // Leaves out holding spelling<TAB>/transcription/
+  void finish(std::string& out) const {
+    out += "\t/";
+    std::rotate(out.begin() + spelling_end, out.begin() + spelling_end + size, out.end());
+    out += '/';
+  }
+
+ private:
+  std::size_t spelling_end;
+  std::size_t size = 0;
+  bool boundaries;
+};
+
+// Appends a word to out as get_word does, calling visit(syllable, origin, out) once each syllable
+// has been spelled
+template <class T, class Visit>
+void get_syllables(const System<T>& s, Rng& rng, int max_num_syllables, std::string& out,
+                   Visit&& visit) {
+  int num_syllables = uniform(rng, max_num_syllables) + 1;
+  for (int i = 0; i < num_syllables; ++i) {
+    SyllableOrigin origin;
+    Syllable syllable = s.get_syllable(rng, origin);
+    s.get_spelling(syllable, i == num_syllables - 1, rng, out);
+    visit(syllable, origin, out);
+  }
 }
-inline bool in_cluster  (Spelling::RuleParams rp) {
-  return !not_in_cluster(rp);
+
+// Appends a word to out, transcribed if asked to; the transcription is drawn from the same
+// syllables and leaves the spelling as it would be without. Once out has grown to fit the longest
+// word seen, this does not allocate.
+template <class T>
+void get_word(const System<T>& s, Rng& rng, int max_num_syllables, std::string& out,
+              Transcription transcription = Transcription::NONE) {
+  if (transcription == Transcription::NONE) {
+    get_syllables(s, rng, max_num_syllables, out,
+                  [](const Syllable&, const SyllableOrigin&, std::string&) {});
+    return;
+  }
+  Transcript transcript(out, transcription == Transcription::IPA_SYLLABLES);
+  get_syllables(s, rng, max_num_syllables, out,
+                [&](const Syllable& syllable, const SyllableOrigin&, std::string& word) {
+                  transcript.add(syllable, word);
+                });
+  transcript.finish(out);
 }
-inline bool word_initial    (Spelling::RuleParams rp) { return rp.prev == nullptr; };
-inline bool not_word_initial(Spelling::RuleParams rp) { return !word_initial(rp); }
-inline bool between_vowels  (Spelling::RuleParams rp) {
-  return (rp.prev && !rp.word_final && rp.prev->vowel && (rp.next == nullptr));
+
+template <class T>
+std::string get_word(const System<T>& s, Rng& rng, int max_num_syllables) {
+  std::string word;
+  get_word(s, rng, max_num_syllables, word);
+  return word;
 }
-inline bool before_vowel    (Spelling::RuleParams rp) { return rp.next && rp.next->vowel; }
-inline bool mid_word        (Spelling::RuleParams rp) { return rp.prev && !rp.word_final; }
 
-bool homorganic(const Phone* lhs, const Phone* rhs);
-Phone get_phone(IPA symbol);
+// The words get_word draws one after another, as an endless input range. Every word is a view of
+// one buffer owned by the range, reserved up front and overwritten when the iterator advances, so
+// pipelines such as words(s, rng, 3) | std::views::filter(...) | std::views::take(n) allocate
+// nothing per word. As with std::ranges::istream_view, the range must outlive its iterators and
+// must not be moved once begin() has been called.
+template <class T>
+class WordView : public std::ranges::view_interface<WordView<T>> {
+ public:
+  WordView(const System<T>& system, Rng& rng, int max_num_syllables)
+      : system(&system), rng(&rng), max_num_syllables(max_num_syllables) {
+    word.reserve(256);
+  }
+
+  class iterator {
+   public:
+    using difference_type = std::ptrdiff_t;
+    using value_type = std::string_view;
+
+    iterator() = default;
+    explicit iterator(WordView* parent) : parent(parent) {}
+
+    std::string_view operator*() const { return parent->word; }
+    iterator& operator++() {
+      parent->next();
+      return *this;
+    }
+    void operator++(int) { ++*this; }
+
+   private:
+    WordView* parent = nullptr;
+  };
+
+  // Draws the first word
+  iterator begin() {
+    next();
+    return iterator(this);
+  }
+  std::unreachable_sentinel_t end() const { return {}; }
+
+ private:
+  void next() {
+    word.clear();
+    get_word(*system, *rng, max_num_syllables, word);
+  }
+
+  const System<T>* system;
+  Rng* rng;
+  int max_num_syllables;
+  std::string word;
+};
 
-namespace {
 template <class T>
-static std::string get_syllable(const phonology::System<T>& s, bool final) {
-  std::string syllable_string;
-  Syllable syllable;
-  syllable.onset = s.get_onset();
-  syllable.nucleus = s.get_nucleus(syllable.onset.back());
-  syllable.coda = s.get_coda(syllable.nucleus);
-  return s.get_spelling(syllable, final);
+WordView<T> words(const System<T>& s, Rng& rng, int max_num_syllables) {
+  return WordView<T>(s, rng, max_num_syllables);
 }
-}  // namespace
 
+// Words packed back to back, as in an Arrow string column: word i is
+// chars[offsets[i], offsets[i + 1]). No per-word allocation, and the buffers can be handed to
+// consumers as they are.
+struct WordBatch {
+  std::string chars;
+  std::vector<uint32_t> offsets{0};
+
+  std::size_t size() const { return offsets.size() - 1; }
+  std::string_view operator[](std::size_t i) const {
+    return std::string_view(chars).substr(offsets[i], offsets[i + 1] - offsets[i]);
+  }
+  void clear() {
+    chars.clear();
+    offsets.assign(1, 0);
+  }
+};
+
+// Appends n words to out. Reusing out across calls keeps its buffers, so steady-state batches do
+// not allocate.
 template <class T>
-std::string get_word(const System<T>& s, int max_num_syllables) {
-  int num_syllables = (rand() % max_num_syllables) + 1;
-  std::string word;
-  bool prev_onset = false;
-  bool prev_coda = false;
-  for (int i = 0; i < num_syllables; ++i) {
-    bool coda = false;
-    bool onset = !prev_coda;
-    if (i == 0) {
-      onset = rand() % 8;
-    }
-    if (!prev_onset) {
-      coda = rand() % 2;
-    }
-    word += get_syllable(s, i == num_syllables - 1);
-    prev_onset = onset;
-    prev_coda = coda;
+void generate_batch(const System<T>& s, Rng& rng, std::size_t n, int max_num_syllables,
+                    WordBatch& out) {
+  out.offsets.reserve(out.offsets.size() + n);
+  for (std::size_t i = 0; i < n; ++i) {
+    get_word(s, rng, max_num_syllables, out.chars);
+    assert(out.chars.size() <= UINT32_MAX);
+    out.offsets.push_back(out.chars.size());
   }
-  return word;
+}
+
+template <class T>
+WordBatch generate_batch(const System<T>& s, Rng& rng, std::size_t n, int max_num_syllables) {
+  WordBatch batch;
+  generate_batch(s, rng, n, max_num_syllables, batch);
+  return batch;
 }
 
 };  // namespace phonology
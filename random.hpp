@@ -0,0 +1,299 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace phonology {
+
+// xoshiro256** by Blackman and Vigna. Small state, no global data, and fast enough that the
+// generator no longer shows up next to the table lookups it feeds.
+class Xoshiro256StarStar {
+ public:
+  using result_type = uint64_t;
+
+  explicit Xoshiro256StarStar(uint64_t seed = 0) {
+    // Expand the seed with splitmix64 so that similar seeds give unrelated streams
+    for (auto& word : s) {
+      seed += 0x9e3779b97f4a7c15;
+      uint64_t z = seed;
+      z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+      z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+      word = z ^ (z >> 31);
+    }
+  }
+
+  // Starts from the given state, which must not be all zero
+  explicit Xoshiro256StarStar(const uint64_t (&state)[4]) {
+    for (int i = 0; i < 4; ++i) {
+      s[i] = state[i];
+    }
+  }
+
+  static constexpr result_type min() { return std::numeric_limits<result_type>::min(); }
+  static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+  result_type operator()() {
+    const uint64_t result = rotl(s[1] * 5, 7) * 9;
+    const uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+    return result;
+  }
+
+  // Equivalent to 2^128 calls to operator(), used to hand out non-overlapping streams
+  void jump() {
+    static constexpr uint64_t kJump[] = {0x180ec6d33cfd0aba, 0xd5a61266f0c9392c,
+                                         0xa9582618e03fc9aa, 0x39abdc4529b1661c};
+    uint64_t t[4] = {};
+    for (uint64_t j : kJump) {
+      for (int b = 0; b < 64; ++b) {
+        if (j & (uint64_t{1} << b)) {
+          for (int i = 0; i < 4; ++i) {
+            t[i] ^= s[i];
+          }
+        }
+        (*this)();
+      }
+    }
+    for (int i = 0; i < 4; ++i) {
+      s[i] = t[i];
+    }
+  }
+
+ private:
+  static constexpr uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+  uint64_t s[4];
+};
+
+// The engine used throughout the word pipeline
+using Rng = Xoshiro256StarStar;
+
+// Philox4x32-10 by Salmon et al., a counter-based generator: block number counter of the stream
+// keyed by key is computed directly, with no state carried from one block to the next
+class Philox4x32 {
+ public:
+  using Block = std::array<uint32_t, 4>;
+
+  static Block generate(uint64_t key, Block counter) {
+    uint32_t k0 = static_cast<uint32_t>(key);
+    uint32_t k1 = static_cast<uint32_t>(key >> 32);
+    for (int round = 0; round < 10; ++round) {
+      uint64_t p0 = static_cast<uint64_t>(0xd2511f53) * counter[0];
+      uint64_t p1 = static_cast<uint64_t>(0xcd9e8d57) * counter[2];
+      counter = {static_cast<uint32_t>(p1 >> 32) ^ counter[1] ^ k0, static_cast<uint32_t>(p1),
+                 static_cast<uint32_t>(p0 >> 32) ^ counter[3] ^ k1, static_cast<uint32_t>(p0)};
+      k0 += 0x9e3779b9;
+      k1 += 0xbb67ae85;
+    }
+    return counter;
+  }
+};
+
+// The generator for item n of the stream keyed by seed, started from the Philox blocks for
+// (seed, n). Any item can be regenerated on its own, so the items of a stream can be produced in
+// any order, on any number of threads or machines, with identical results.
+inline Rng counter_rng(uint64_t seed, uint64_t n) {
+  uint64_t state[4];
+  for (uint32_t half = 0; half < 2; ++half) {
+    Philox4x32::Block block = Philox4x32::generate(
+        seed, {static_cast<uint32_t>(n), static_cast<uint32_t>(n >> 32), half, 0});
+    state[2 * half] = static_cast<uint64_t>(block[1]) << 32 | block[0];
+    state[2 * half + 1] = static_cast<uint64_t>(block[3]) << 32 | block[2];
+  }
+  return Rng(state);
+}
+
+// Unbiased draw in [0, n) using Lemire's multiply-shift method. The modulo only runs in the
+// rare case where the low half of the product lands in the biased region.
+template <class Engine>
+inline uint64_t uniform(Engine& rng, uint64_t n) {
+  __uint128_t m = static_cast<__uint128_t>(rng()) * n;
+  uint64_t l = static_cast<uint64_t>(m);
+  if (l < n) {
+    uint64_t t = -n % n;
+    while (l < t) {
+      m = static_cast<__uint128_t>(rng()) * n;
+      l = static_cast<uint64_t>(m);
+    }
+  }
+  return static_cast<uint64_t>(m >> 64);
+}
+
+// Uniform double in [0, 1)
+template <class Engine>
+inline double uniform_real(Engine& rng) {
+  return static_cast<double>(rng() >> 11) * 0x1.0p-53;
+}
+
+// A keyed pseudo-random bijection on [0, n), for n > 0: a balanced Feistel network over the
+// smallest even number of bits that covers n, cycle-walked until the result lands back in range.
+// Each call takes fewer than four passes through the network on average, and no state beyond the
+// keys.
+class FeistelPermutation {
+ public:
+  FeistelPermutation(__uint128_t n, uint64_t key) : n(n) {
+    int bits = 2;
+    while (bits < 128 && (__uint128_t{1} << bits) < n) {
+      bits += 2;
+    }
+    half_bits = bits / 2;
+    half_mask = half_bits == 64 ? ~uint64_t{0} : (uint64_t{1} << half_bits) - 1;
+    Xoshiro256StarStar keys_rng(key);
+    for (auto& k : keys) {
+      k = keys_rng();
+    }
+  }
+
+  __uint128_t operator()(__uint128_t i) const {
+    do {
+      i = encrypt(i);
+    } while (i >= n);
+    return i;
+  }
+
+ private:
+  __uint128_t encrypt(__uint128_t i) const {
+    uint64_t left = static_cast<uint64_t>(i >> half_bits);
+    uint64_t right = static_cast<uint64_t>(i) & half_mask;
+    for (uint64_t k : keys) {
+      uint64_t f = (right ^ k) * 0xbf58476d1ce4e5b9;
+      f = (f ^ (f >> 31)) * 0x94d049bb133111eb;
+      left ^= (f ^ (f >> 29)) & half_mask;
+      std::swap(left, right);
+    }
+    return static_cast<__uint128_t>(left) << half_bits | right;
+  }
+
+  __uint128_t n;
+  int half_bits;
+  uint64_t half_mask;
+  uint64_t keys[4];
+};
+
+// Walker/Vose alias tables for many small discrete distributions stored back to back. A weighted
+// draw is one bounded draw to pick a slot plus one coin flip against that slot's threshold. Slots
+// that always keep their own outcome skip the coin flip, so uniform distributions cost the same as
+// a plain bounded draw. The tables only view their slots, which AliasTablesBuilder fills or a
+// phonology image holds.
+class AliasTables {
+ public:
+  static constexpr uint32_t kAlways = std::numeric_limits<uint32_t>::max();
+
+  AliasTables() = default;
+  AliasTables(std::span<const uint32_t> threshold, std::span<const uint16_t> alias)
+      : threshold(threshold), alias(alias) {}
+
+  // Weighted draw from the distribution occupying slots [offset, offset + size)
+  template <class Engine>
+  std::size_t sample(std::size_t offset, std::size_t size, Engine& rng) const {
+    std::size_t i = uniform(rng, size);
+    uint32_t t = threshold[offset + i];
+    if (t == kAlways || static_cast<uint32_t>(rng() >> 32) < t) {
+      return i;
+    }
+    return alias[offset + i];
+  }
+
+  // The exact probability of each outcome of sample(offset, size, rng), thresholds rounding
+  // included
+  std::vector<double> probabilities(std::size_t offset, std::size_t size) const {
+    std::vector<double> p(size);
+    for (std::size_t i = 0; i < size; ++i) {
+      uint32_t t = threshold[offset + i];
+      double keep = t == kAlways ? 1 : std::ldexp(t, -32);
+      p[i] += keep / size;
+      p[alias[offset + i]] += (1 - keep) / size;
+    }
+    return p;
+  }
+
+  std::size_t size() const { return threshold.size(); }
+  // Whether the slots [offset, offset + size) exist and only alias outcomes among themselves
+  bool valid(std::size_t offset, std::size_t size) const {
+    if (threshold.size() != alias.size() || offset > threshold.size() ||
+        size > threshold.size() - offset) {
+      return false;
+    }
+    for (std::size_t i = offset; i < offset + size; ++i) {
+      if (alias[i] >= size) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+ private:
+  std::span<const uint32_t> threshold;
+  std::span<const uint16_t> alias;
+};
+
+// Lays out the slots of AliasTables, one distribution after another
+class AliasTablesBuilder {
+ public:
+  // Appends a distribution over [0, weights.size()), occupying the next weights.size() slots
+  void add(std::span<const double> weights) {
+    const std::size_t n = weights.size();
+    const std::size_t base = threshold.size();
+    threshold.resize(base + n, AliasTables::kAlways);
+    alias.resize(base + n);
+    for (std::size_t i = 0; i < n; ++i) {
+      alias[base + i] = i;
+    }
+
+    double total = 0;
+    bool equal = true;
+    for (double w : weights) {
+      total += w;
+      equal = equal && w == weights.front();
+    }
+    if (equal || total <= 0) {
+      return;
+    }
+
+    std::vector<double> scaled(n);
+    std::vector<std::size_t> small;
+    std::vector<std::size_t> large;
+    for (std::size_t i = 0; i < n; ++i) {
+      scaled[i] = weights[i] * n / total;
+      (scaled[i] < 1 ? small : large).push_back(i);
+    }
+    while (!small.empty() && !large.empty()) {
+      std::size_t s = small.back();
+      std::size_t l = large.back();
+      small.pop_back();
+      threshold[base + s] = to_threshold(scaled[s]);
+      alias[base + s] = l;
+      scaled[l] -= 1 - scaled[s];
+      if (scaled[l] < 1) {
+        large.pop_back();
+        small.push_back(l);
+      }
+    }
+    // Whatever is left over is 1 up to rounding and keeps its own outcome
+  }
+
+  // A view of the slots laid out so far, valid until the next add
+  AliasTables view() const { return AliasTables(threshold, alias); }
+
+  std::vector<uint32_t> threshold;
+  std::vector<uint16_t> alias;
+
+ private:
+  static uint32_t to_threshold(double p) {
+    double t = std::ldexp(p, 32);
+    return t >= AliasTables::kAlways ? AliasTables::kAlways : static_cast<uint32_t>(t);
+  }
+};
+
+}  // namespace phonology
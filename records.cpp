@@ -0,0 +1,87 @@
+#include "records.hpp"
+
+#include <algorithm>
+
+namespace phonology {
+
+// Private functions
+
+namespace {
+
+// Whether offsets start at 0, never decrease and end at size
+bool valid_offsets(std::span<const uint32_t> offsets, std::size_t size) {
+  return !offsets.empty() && offsets.front() == 0 && std::ranges::is_sorted(offsets) &&
+         offsets.back() == size;
+}
+
+}  // namespace
+
+// Public functions
+
+void RecordBatch::clear() {
+  chars.clear();
+  char_offsets.assign(1, 0);
+  syllable_offsets.assign(1, 0);
+  phonemes.clear();
+  phoneme_offsets.assign(1, 0);
+  onset_sizes.clear();
+  onset_groups.clear();
+  coda_groups.clear();
+}
+
+void RecordBatch::write(OutputWriter& out) const {
+  GatherImageWriter image;
+  image.write(std::span<const char>(chars));
+  image.write(char_offsets);
+  image.write(syllable_offsets);
+  image.write(phonemes);
+  image.write(phoneme_offsets);
+  image.write(onset_sizes);
+  image.write(onset_groups);
+  image.write(coda_groups);
+  image.finish(out);
+}
+
+void RecordView::transcribe(std::size_t word, std::string& out) const {
+  out += spelling(word);
+  out += "\t/";
+  for (std::size_t k = syllable_offsets[word]; k < syllable_offsets[word + 1]; ++k) {
+    if (k > syllable_offsets[word]) {
+      out += '.';
+    }
+    for (std::size_t i = phoneme_offsets[k]; i < phoneme_offsets[k + 1]; ++i) {
+      out += kIpaSymbols[phonemes[i]];
+    }
+  }
+  out += '/';
+}
+
+bool RecordView::read(std::span<const std::byte> image) {
+  ImageReader reader(image);
+  chars = reader.read<char>();
+  char_offsets = reader.read<uint32_t>();
+  syllable_offsets = reader.read<uint32_t>();
+  phonemes = reader.read<uint8_t>();
+  phoneme_offsets = reader.read<uint32_t>();
+  onset_sizes = reader.read<uint8_t>();
+  onset_groups = reader.read<uint8_t>();
+  coda_groups = reader.read<uint8_t>();
+  const std::size_t num_syllables = onset_sizes.size();
+  if (!reader.complete() || !valid_offsets(char_offsets, chars.size()) ||
+      syllable_offsets.size() != char_offsets.size() ||
+      !valid_offsets(syllable_offsets, num_syllables) ||
+      !valid_offsets(phoneme_offsets, phonemes.size()) ||
+      phoneme_offsets.size() != num_syllables + 1 || onset_groups.size() != num_syllables ||
+      coda_groups.size() != num_syllables) {
+    return false;
+  }
+  for (std::size_t k = 0; k < num_syllables; ++k) {
+    // Every syllable has a nucleus after its onset
+    if (onset_sizes[k] >= phoneme_offsets[k + 1] - phoneme_offsets[k]) {
+      return false;
+    }
+  }
+  return std::ranges::all_of(phonemes, [](uint8_t p) { return p < std::size(kPhones); });
+}
+
+}  // namespace phonology
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "image.hpp"
+#include "output.hpp"
+#include "phonology.hpp"
+#include "random.hpp"
+
+namespace phonology {
+
+// Words with their structure, column by column, for pipelines that would otherwise parse text
+// back into it. Word w is spelled chars[char_offsets[w], char_offsets[w + 1]) and made of
+// syllables [syllable_offsets[w], syllable_offsets[w + 1]). Syllable k is the phonemes
+// [phoneme_offsets[k], phoneme_offsets[k + 1]), as IPA symbols, of which the first onset_sizes[k]
+// are its onset, the next its nucleus and the rest its coda; onset_groups[k] and coda_groups[k]
+// are the groups of System::onsets and codas those came from, kNoCoda for no coda.
+//
+// A batch is written as one phonology image with an array per column in that order, and a record
+// stream is batches written one after another. Image::map_stream maps one, and RecordView reads
+// the columns of each batch in place.
+struct RecordBatch {
+  static constexpr uint8_t kNoCoda = UINT8_MAX;
+
+  std::string chars;
+  std::vector<uint32_t> char_offsets{0};
+  std::vector<uint32_t> syllable_offsets{0};
+  std::vector<uint8_t> phonemes;
+  std::vector<uint32_t> phoneme_offsets{0};
+  std::vector<uint8_t> onset_sizes;
+  std::vector<uint8_t> onset_groups;
+  std::vector<uint8_t> coda_groups;
+
+  std::size_t size() const { return char_offsets.size() - 1; }
+  void clear();
+  void write(OutputWriter& out) const;
+};
+
+// The columns of a batch read back from a record stream, as views of the mapping
+struct RecordView {
+  std::span<const char> chars;
+  std::span<const uint32_t> char_offsets;
+  std::span<const uint32_t> syllable_offsets;
+  std::span<const uint8_t> phonemes;
+  std::span<const uint32_t> phoneme_offsets;
+  std::span<const uint8_t> onset_sizes;
+  std::span<const uint8_t> onset_groups;
+  std::span<const uint8_t> coda_groups;
+
+  // Reads the columns of the batch image, or returns false if it does not hold a consistent
+  // batch
+  bool read(std::span<const std::byte> image);
+
+  std::size_t size() const { return char_offsets.size() - 1; }
+  std::string_view spelling(std::size_t word) const {
+    return {chars.data() + char_offsets[word], char_offsets[word + 1] - char_offsets[word]};
+  }
+  // Appends word as get_word does with Transcription::IPA_SYLLABLES, the way back to text
+  void transcribe(std::size_t word, std::string& out) const;
+};
+
+// Appends a word drawn as get_word draws it to out, with its structure. Once out has grown to
+// fit, this does not allocate.
+template <class T>
+void get_record(const System<T>& s, Rng& rng, int max_num_syllables, RecordBatch& out) {
+  get_syllables(s, rng, max_num_syllables, out.chars,
+                [&](const Syllable& syllable, const SyllableOrigin& origin, std::string&) {
+                  auto add = [&](const Phoneme* p) {
+                    out.phonemes.push_back(static_cast<uint8_t>(p->p.symbol));
+                  };
+                  for (const Phoneme* p : syllable.onset) {
+                    add(p);
+                  }
+                  add(syllable.nucleus);
+                  for (const Phoneme* p : syllable.coda) {
+                    add(p);
+                  }
+                  assert(out.phonemes.size() <= UINT32_MAX);
+                  out.phoneme_offsets.push_back(out.phonemes.size());
+                  out.onset_sizes.push_back(syllable.onset.size());
+                  // Groups are stored in bytes, with the last value kept for no coda
+                  std::size_t onset_group = s.onset_group_of(origin.onset);
+                  assert(onset_group < RecordBatch::kNoCoda);
+                  out.onset_groups.push_back(onset_group);
+                  if (origin.coda == SyllableOrigin::kNoCoda) {
+                    out.coda_groups.push_back(RecordBatch::kNoCoda);
+                  } else {
+                    std::size_t coda_group = s.coda_group_of(origin.coda);
+                    assert(coda_group < RecordBatch::kNoCoda);
+                    out.coda_groups.push_back(coda_group);
+                  }
+                });
+  assert(out.chars.size() <= UINT32_MAX);
+  out.char_offsets.push_back(out.chars.size());
+  out.syllable_offsets.push_back(out.onset_sizes.size());
+}
+
+}  // namespace phonology
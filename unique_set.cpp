@@ -0,0 +1,38 @@
+#include "unique_set.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <functional>
+
+namespace phonology {
+
+UniqueSet::UniqueSet(std::size_t max_words) : max_words(max_words) {
+  // Keep the load factor at or below 3/4 so that probe sequences stay short
+  std::size_t capacity = std::bit_ceil(std::max<std::size_t>(max_words + max_words / 3, 16));
+  mask = capacity - 1;
+  shift = 64 - std::countr_zero(capacity);
+  slots.reset(new std::atomic<uint64_t>[capacity]());
+}
+
+bool UniqueSet::insert(std::string_view word) {
+  // Zero marks an empty slot
+  uint64_t fingerprint = std::hash<std::string_view>{}(word) | 1;
+  // Take the slot from the high bits of a multiplicative hash, so it does not just reuse the low
+  // bits of the fingerprint
+  for (std::size_t i = (fingerprint * 0x9e3779b97f4a7c15) >> shift;; i = (i + 1) & mask) {
+    uint64_t current = slots[i].load(std::memory_order_relaxed);
+    if (current == 0) {
+      assert(size() < max_words);
+      if (slots[i].compare_exchange_strong(current, fingerprint, std::memory_order_relaxed)) {
+        count.fetch_add(1, std::memory_order_relaxed);
+        return true;
+      }
+    }
+    if (current == fingerprint) {
+      return false;
+    }
+  }
+}
+
+}  // namespace phonology
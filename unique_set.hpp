@@ -0,0 +1,33 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+
+namespace phonology {
+
+// Concurrent set of words for deduplication, sized up front for the number of words it will hold.
+// Only a 64-bit fingerprint of each word is kept, in an open-addressed table of atomic slots, so
+// 10^8 words take 2 GiB and inserts from many threads need no locks. A fingerprint collision makes
+// a new word look like a duplicate, never the other way round, so the words accepted are always
+// distinct.
+class UniqueSet {
+ public:
+  explicit UniqueSet(std::size_t max_words);
+
+  // True if the word was not in the set yet
+  bool insert(std::string_view word);
+  std::size_t size() const { return count.load(std::memory_order_relaxed); }
+  std::size_t max_size() const { return max_words; }
+
+ private:
+  std::size_t max_words;
+  std::size_t mask;
+  int shift;
+  std::unique_ptr<std::atomic<uint64_t>[]> slots;
+  std::atomic<std::size_t> count = 0;
+};
+
+}  // namespace phonology
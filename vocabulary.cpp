@@ -0,0 +1,377 @@
+#include "vocabulary.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+
+#include "output.hpp"
+
+namespace phonology {
+
+namespace {
+
+Vocabulary::Count add(Vocabulary::Count a, Vocabulary::Count b) {
+  return a > Vocabulary::kMaxCount - b ? Vocabulary::kMaxCount : a + b;
+}
+
+Vocabulary::Count multiply(Vocabulary::Count a, Vocabulary::Count b) {
+  return b && a > Vocabulary::kMaxCount / b ? Vocabulary::kMaxCount : a * b;
+}
+
+}  // namespace
+
+void Vocabulary::Trie::build(std::vector<std::pair<std::string, double>>&& syllables) {
+  num_derivations = syllables.size();
+  std::sort(syllables.begin(), syllables.end());
+  std::size_t merged = 0;
+  for (auto& [spelling, p] : syllables) {
+    assert(!spelling.empty());
+    if (merged && syllables[merged - 1].first == spelling) {
+      syllables[merged - 1].second += p;
+    } else {
+      syllables[merged++] = {std::move(spelling), p};
+    }
+  }
+  syllables.resize(merged);
+
+  // Each node's edges are reserved together before any of its children is built, so they stay
+  // contiguous and in byte order
+  nodes.assign(1, {});
+  edges.clear();
+  auto add = [&](auto& self, uint32_t node, std::size_t lo, std::size_t hi, std::size_t depth)
+      -> void {
+    if (syllables[lo].first.size() == depth) {
+      nodes[node].p = syllables[lo++].second;
+    }
+    nodes[node].first_edge = edges.size();
+    for (std::size_t i = lo; i < hi; ++i) {
+      if (i == lo || syllables[i].first[depth] != syllables[i - 1].first[depth]) {
+        edges.emplace_back(syllables[i].first[depth], 0);
+        ++nodes[node].num_edges;
+      }
+    }
+    uint32_t edge = nodes[node].first_edge;
+    while (lo < hi) {
+      unsigned char c = syllables[lo].first[depth];
+      std::size_t end = lo;
+      while (end < hi && static_cast<unsigned char>(syllables[end].first[depth]) == c) {
+        ++end;
+      }
+      uint32_t child = nodes.size();
+      nodes.emplace_back();
+      edges[edge++].second = child;
+      self(self, child, lo, end, depth + 1);
+      lo = end;
+    }
+  };
+  if (!syllables.empty()) {
+    add(add, 0, 0, syllables.size(), 0);
+  }
+}
+
+uint32_t Vocabulary::Trie::child(uint32_t node, unsigned char c) const {
+  auto first = edges.begin() + nodes[node].first_edge;
+  auto last = first + nodes[node].num_edges;
+  auto it = std::lower_bound(first, last, c, [](const auto& e, unsigned char c) {
+    return e.first < c;
+  });
+  return it != last && it->first == c ? it->second : 0;
+}
+
+void Vocabulary::init(
+    const std::function<void(bool, const SpellingVisitor&)>& for_each_syllable) {
+  assert(max_num_syllables >= 1);
+  for (bool word_final : {false, true}) {
+    std::vector<std::pair<std::string, double>> syllables;
+    for_each_syllable(word_final, [&](std::string_view spelling, double p) {
+      if (p > 0) {
+        syllables.emplace_back(spelling, p);
+      }
+    });
+    (word_final ? final : non_final).build(std::move(syllables));
+  }
+}
+
+std::vector<unsigned char> Vocabulary::next_bytes(const States& states) const {
+  std::vector<unsigned char> bytes;
+  for (const auto& [s, w] : states) {
+    const Trie& t = trie(s);
+    const Trie::Node& n = t.nodes[node(s)];
+    for (uint32_t e = n.first_edge; e < n.first_edge + n.num_edges; ++e) {
+      bytes.push_back(t.edges[e].first);
+    }
+  }
+  std::sort(bytes.begin(), bytes.end());
+  bytes.erase(std::unique(bytes.begin(), bytes.end()), bytes.end());
+  return bytes;
+}
+
+void Vocabulary::step(const States& from, unsigned char c, States& to) const {
+  to.clear();
+  for (const auto& [s, w] : from) {
+    const Trie& t = trie(s);
+    uint32_t child = t.child(node(s), c);
+    if (!child) {
+      continue;
+    }
+    const Trie::Node& n = t.nodes[child];
+    // States that can neither continue nor end the word are dropped, so that equal futures have
+    // equal state sets
+    if (n.num_edges || !remaining(s)) {
+      to.emplace_back(state(remaining(s), child), w);
+    }
+    if (remaining(s) && n.p > 0) {
+      to.emplace_back(state(remaining(s) - 1, 0), w * n.p);
+    }
+  }
+  std::sort(to.begin(), to.end());
+  std::size_t merged = 0;
+  for (const auto& [s, w] : to) {
+    if (merged && to[merged - 1].first == s) {
+      to[merged - 1].second += w;
+    } else {
+      to[merged++] = {s, w};
+    }
+  }
+  to.resize(merged);
+}
+
+double Vocabulary::end_probability(const States& states) const {
+  double p = 0;
+  for (const auto& [s, w] : states) {
+    if (!remaining(s)) {
+      p += w * final.nodes[node(s)].p;
+    }
+  }
+  return p;
+}
+
+Vocabulary::States Vocabulary::start() const {
+  States states;
+  for (int k = 0; k < max_num_syllables; ++k) {
+    states.emplace_back(state(k, 0), 1.0 / max_num_syllables);
+  }
+  return states;
+}
+
+Vocabulary::Count Vocabulary::count(const States& states) const {
+  key.clear();
+  for (const auto& [s, w] : states) {
+    key.push_back(s);
+  }
+  if (Count n; saved.find(key, n)) {
+    return n;
+  }
+  if (auto it = counts.find(key); it != counts.end()) {
+    return it->second;
+  }
+  std::vector<State> states_key = key;
+
+  Count n = end_probability(states) > 0;
+  if (count_levels.size() <= count_depth) {
+    count_levels.resize(count_depth + 1);
+  }
+  for (unsigned char c : next_bytes(states)) {
+    States& next = count_levels[count_depth];
+    step(states, c, next);
+    ++count_depth;
+    n = add(n, count(next));
+    --count_depth;
+  }
+  counts.emplace(std::move(states_key), n);
+  return n;
+}
+
+Vocabulary::Count Vocabulary::num_derivations() const {
+  Count total = 0;
+  Count prefixes = 1;
+  for (int k = 1; k <= max_num_syllables; ++k) {
+    total = add(total, multiply(prefixes, final.num_derivations));
+    prefixes = multiply(prefixes, non_final.num_derivations);
+  }
+  return total;
+}
+
+Vocabulary::Count Vocabulary::num_words() const { return count(start()); }
+
+void Vocabulary::word_at(Count index, std::string& out) const {
+  assert(index < num_words() && num_words() != kMaxCount);
+  States states = start();
+  States next;
+  // Words come before their extensions, and extensions in the order of their next byte
+  while (end_probability(states) == 0 || index-- > 0) {
+    for (unsigned char c : next_bytes(states)) {
+      step(states, c, next);
+      Count n = count(next);
+      if (index < n) {
+        out.push_back(c);
+        break;
+      }
+      index -= n;
+    }
+    std::swap(states, next);
+  }
+}
+
+std::string Vocabulary::word_at(Count index) const {
+  std::string word;
+  word_at(index, word);
+  return word;
+}
+
+Vocabulary::Count Vocabulary::index_of(std::string_view word) const {
+  assert(num_words() != kMaxCount);
+  Count index = 0;
+  States states = start();
+  States next;
+  for (unsigned char c : word) {
+    index += end_probability(states) > 0;
+    for (unsigned char b : next_bytes(states)) {
+      if (b >= c) {
+        break;
+      }
+      step(states, b, next);
+      index += count(next);
+    }
+    step(states, c, next);
+    if (next.empty()) {
+      return kNoIndex;
+    }
+    std::swap(states, next);
+  }
+  return end_probability(states) > 0 ? index : kNoIndex;
+}
+
+void Vocabulary::for_each_word(const WordVisitor& visit) const {
+  std::vector<States> levels(1);
+  for (int k = 0; k < max_num_syllables; ++k) {
+    levels[0].emplace_back(state(k, 0), 1.0 / max_num_syllables);
+  }
+  std::string word;
+  auto walk = [&](auto& self, std::size_t depth) -> void {
+    if (double p = end_probability(levels[depth]); p > 0) {
+      visit(word, p);
+    }
+    if (levels.size() <= depth + 1) {
+      levels.resize(depth + 2);
+    }
+    for (unsigned char c : next_bytes(levels[depth])) {
+      step(levels[depth], c, levels[depth + 1]);
+      word.push_back(c);
+      self(self, depth + 1);
+      word.pop_back();
+    }
+  };
+  walk(walk, 0);
+}
+
+void Vocabulary::save_counts(const char* path) const {
+  // Counts already adopted are not in the cache to be written again
+  assert(saved.slots.empty());
+  num_words();
+  std::vector<uint32_t> key_offsets = {0};
+  std::vector<State> key_states;
+  std::vector<uint64_t> values;
+  std::vector<uint32_t> slots(std::bit_ceil(2 * counts.size() + 1));
+  for (const auto& [states, n] : counts) {
+    for (std::size_t slot = Hash()(states);; ++slot) {
+      if (!slots[slot & (slots.size() - 1)]) {
+        slots[slot & (slots.size() - 1)] = key_offsets.size();
+        break;
+      }
+    }
+    key_states.insert(key_states.end(), states.begin(), states.end());
+    if (key_states.size() > UINT32_MAX) {
+      std::fprintf(stderr, "vocabulary: too many counts to save\n");
+      std::abort();
+    }
+    key_offsets.push_back(key_states.size());
+    values.push_back(static_cast<uint64_t>(n));
+    values.push_back(static_cast<uint64_t>(n >> 64));
+  }
+  // The tries are saved along, so that load_counts can tell whose counts these are
+  std::vector<unsigned char> edge_bytes[2];
+  std::vector<uint32_t> edge_children[2];
+  GatherImageWriter image;
+  image.write(std::span<const int>(&max_num_syllables, 1));
+  for (int i = 0; i < 2; ++i) {
+    const Trie& t = i ? final : non_final;
+    for (const auto& [c, child] : t.edges) {
+      edge_bytes[i].push_back(c);
+      edge_children[i].push_back(child);
+    }
+    image.write(t.nodes);
+    image.write(edge_bytes[i]);
+    image.write(edge_children[i]);
+  }
+  image.write(key_offsets);
+  image.write(key_states);
+  image.write(values);
+  image.write(slots);
+  OutputWriter out(path);
+  image.finish(out);
+}
+
+void Vocabulary::load_counts(Image&& image) {
+  saved.image = std::move(image);
+  ImageReader reader(saved.image);
+  auto params = reader.read<int>();
+  bool valid = params.size() == 1 && params[0] == max_num_syllables;
+  for (const Trie* t : {&non_final, &final}) {
+    auto nodes = reader.read<Trie::Node>();
+    auto edge_bytes = reader.read<unsigned char>();
+    auto edge_children = reader.read<uint32_t>();
+    valid = valid && std::ranges::equal(nodes, t->nodes) && edge_bytes.size() == t->edges.size() &&
+            edge_children.size() == t->edges.size();
+    for (std::size_t e = 0; valid && e < t->edges.size(); ++e) {
+      valid = edge_bytes[e] == t->edges[e].first && edge_children[e] == t->edges[e].second;
+    }
+  }
+  saved.key_offsets = reader.read<uint32_t>();
+  saved.key_states = reader.read<State>();
+  saved.values = reader.read<uint64_t>();
+  saved.slots = reader.read<uint32_t>();
+  // Every probe stops at an empty slot, and every entry a slot names has its states and count
+  const std::size_t n = saved.values.size() / 2;
+  valid = valid && reader.complete() && saved.values.size() == 2 * n &&
+          saved.key_offsets.size() == n + 1 && saved.key_offsets.front() == 0 &&
+          saved.key_offsets.back() == saved.key_states.size() &&
+          std::ranges::is_sorted(saved.key_offsets) && std::has_single_bit(saved.slots.size()) &&
+          saved.slots.size() > n &&
+          std::ranges::all_of(saved.slots, [n](uint32_t e) { return e <= n; });
+  if (!valid) {
+    std::fprintf(stderr, "vocabulary: image does not hold the counts of this vocabulary\n");
+    std::abort();
+  }
+}
+
+bool Vocabulary::SavedCounts::find(std::span<const State> key, Count& n) const {
+  if (slots.empty()) {
+    return false;
+  }
+  for (std::size_t slot = Hash()(key);; ++slot) {
+    uint32_t entry = slots[slot & (slots.size() - 1)];
+    if (!entry--) {
+      return false;
+    }
+    if (std::ranges::equal(key, key_states.subspan(key_offsets[entry],
+                                                   key_offsets[entry + 1] - key_offsets[entry]))) {
+      n = static_cast<Count>(values[2 * entry + 1]) << 64 | values[2 * entry];
+      return true;
+    }
+  }
+}
+
+std::string to_string(Vocabulary::Count n) {
+  std::string digits;
+  do {
+    digits.push_back('0' + static_cast<int>(n % 10));
+    n /= 10;
+  } while (n);
+  std::reverse(digits.begin(), digits.end());
+  return digits;
+}
+
+}  // namespace phonology
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "image.hpp"
+#include "phonology.hpp"
+
+namespace phonology {
+
+// The exact set of words get_word can return for a language and a maximum number of syllables,
+// counted and enumerated without generating it.
+//
+// Syllables are spelled independently of each other except for knowing whether they end the
+// word, so every word is some non-final syllable spellings followed by a final one. The two sets
+// of syllable spellings are kept as tries. Words are walked one byte at a time, tracking every way
+// of splitting the prefix into syllables at once, so a string that several derivations spell is
+// only counted once. Distinct words are counted by dynamic programming over those split states:
+// the words completing a prefix depend only on its set of splits, so the count for each set is
+// computed once, and the work grows with the number of distinct sets rather than of words.
+class Vocabulary {
+ public:
+  // Counts saturate at kMaxCount, which both languages pass at 8 syllables
+  using Count = unsigned __int128;
+  static constexpr Count kMaxCount = ~Count{0};
+  using WordVisitor = std::function<void(std::string_view word, double probability)>;
+
+  template <class T>
+  Vocabulary(const System<T>& system, int max_num_syllables);
+
+  // Ways to derive a word: syllable structures, spellings and syllable counts. Distinct
+  // derivations can spell the same word, so this bounds num_words from above.
+  Count num_derivations() const;
+  // Distinct words
+  Count num_words() const;
+
+  // The distinct words numbered 0 to num_words() - 1 in byte order, for splitting the vocabulary
+  // into ranges or visiting it in a shuffled order without remembering what was seen. Both
+  // directions take time proportional to the word length once the first call, which costs as
+  // much as num_words(), has cached the counts they need. That first call is paid once per
+  // process and Vocabulary, and the cache is never trimmed: for up to 2 to 6 syllables it takes
+  // about 1 to 20 s and 70 to 350 MB. Processes that share a vocabulary, such as the shards of a
+  // shuffled one, can instead load_counts what save_counts wrote once. The cache makes a
+  // Vocabulary unsafe to use from several threads at once. Neither works once num_words()
+  // saturates.
+  //
+  // Appends the word numbered index to out
+  void word_at(Count index, std::string& out) const;
+  std::string word_at(Count index) const;
+  // The number of word, or kNoIndex if get_word never returns it
+  static constexpr Count kNoIndex = kMaxCount;
+  Count index_of(std::string_view word) const;
+  // Calls visit for every distinct word in byte order, with the probability that get_word returns
+  // it. Nothing beyond the current word is held in memory.
+  void for_each_word(const WordVisitor& visit) const;
+
+  // Writes the counts word_at and index_of need as an image, counting them first if need be
+  void save_counts(const char* path) const;
+  // Adopts counts saved from the vocabulary of the same language and number of syllables, which
+  // word_at, index_of and num_words then look up in place instead of counting. Aborts if the
+  // image does not hold them.
+  void load_counts(Image&& image);
+
+ private:
+  struct Trie {
+    struct Node {
+      uint32_t first_edge = 0;
+      uint32_t num_edges = 0;
+      // Probability of a syllable spelled exactly as the path to this node; zero if none is
+      double p = 0;
+
+      bool operator==(const Node&) const = default;
+    };
+    std::vector<Node> nodes;
+    std::vector<std::pair<unsigned char, uint32_t>> edges;
+    std::size_t num_derivations = 0;
+
+    void build(std::vector<std::pair<std::string, double>>&& syllables);
+    // The child along byte c, or 0 (the root, which no edge leads to) if there is none
+    uint32_t child(uint32_t node, unsigned char c) const;
+  };
+
+  // A split state: the syllables still to come after the current one, and the node reached in
+  // the current one. The current syllable is the final one exactly when remaining is zero.
+  using State = uint64_t;
+  static State state(uint32_t remaining, uint32_t node) {
+    return static_cast<uint64_t>(remaining) << 32 | node;
+  }
+  static uint32_t remaining(State s) { return s >> 32; }
+  static uint32_t node(State s) { return static_cast<uint32_t>(s); }
+  const Trie& trie(State s) const { return remaining(s) ? non_final : final; }
+
+  // A set of split states, sorted, each with the probability of having reached it
+  using States = std::vector<std::pair<State, double>>;
+
+  void init(const std::function<void(bool, const SpellingVisitor&)>& for_each_syllable);
+  // Bytes that continue at least one of the states, in order
+  std::vector<unsigned char> next_bytes(const States& states) const;
+  // Follows byte c from every state, starting the next syllable wherever one can end
+  void step(const States& from, unsigned char c, States& to) const;
+  // Probability that the word ends here, zero if no state can end it
+  double end_probability(const States& states) const;
+  // Where every word starts: about to begin each of the possible numbers of syllables
+  States start() const;
+  // Distinct words completing the states, counted once per set of states
+  Count count(const States& states) const;
+
+  int max_num_syllables;
+  Trie non_final;
+  Trie final;
+
+  struct Hash {
+    std::size_t operator()(std::span<const State> states) const {
+      uint64_t h = states.size();
+      for (State s : states) {
+        h = (h ^ s) * 0x9e3779b97f4a7c15;
+        h ^= h >> 29;
+      }
+      return h;
+    }
+  };
+  mutable std::unordered_map<std::vector<State>, Count, Hash> counts;
+  // Counts adopted by load_counts: an open-addressing table of entry + 1 per slot, 0 if empty,
+  // over the states of each entry and its count in two halves, low first
+  struct SavedCounts {
+    Image image;
+    std::span<const uint32_t> key_offsets;
+    std::span<const State> key_states;
+    std::span<const uint64_t> values;
+    std::span<const uint32_t> slots;
+
+    bool find(std::span<const State> key, Count& n) const;
+  };
+  SavedCounts saved;
+  // One States buffer per depth of count, reused across siblings. A deque so that growing it
+  // keeps the buffers of the callers in place.
+  mutable std::deque<States> count_levels;
+  mutable std::size_t count_depth = 0;
+  mutable std::vector<State> key;
+};
+
+template <class T>
+Vocabulary::Vocabulary(const System<T>& system, int max_num_syllables)
+    : max_num_syllables(max_num_syllables) {
+  init([&](bool word_final, const SpellingVisitor& visit) {
+    system.for_each_syllable(word_final, visit);
+  });
+}
+
+std::string to_string(Vocabulary::Count n);
+
+}  // namespace phonology
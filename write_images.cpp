@@ -0,0 +1,57 @@
+#include <cstddef>
+#include <cstdio>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include "american_english.hpp"
+#include "image.hpp"
+#include "metropolitan_french.hpp"
+#include "output.hpp"
+
+// Compiles the built-in languages from their definitions and writes their images out as the C++
+// source of read-only arrays, which the generator links in to load without building anything
+
+namespace {
+
+// Appends the definition of T::builtin_image, returning the image of T as an array aligned as a
+// mapped file is
+template <class T>
+void append_image(std::string_view name, std::string& source) {
+  phonology::Image image = T::compile_definitions();
+  source += "\nstd::span<const std::byte> ";
+  source += name;
+  source += "::builtin_image() {\n  alignas(8) static constexpr unsigned char image[] = {";
+  std::span<const std::byte> bytes = image.bytes();
+  for (std::size_t i = 0; i < bytes.size(); ++i) {
+    char hex[8];
+    std::snprintf(hex, sizeof(hex), "0x%02x,", static_cast<unsigned>(bytes[i]));
+    source += i % 16 ? " " : "\n      ";
+    source += hex;
+  }
+  source += "\n  };\n  return std::as_bytes(std::span(image));\n}\n";
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  if (argc != 2) {
+    std::fprintf(stderr, "usage: %s OUTPUT.cpp\n", argv[0]);
+    return 1;
+  }
+  std::string source =
+      "// Generated by write_images.cpp from the language definitions. Do not edit.\n"
+      "#include <cstddef>\n"
+      "#include <span>\n"
+      "\n"
+      "#include \"american_english.hpp\"\n"
+      "#include \"metropolitan_french.hpp\"\n"
+      "\n"
+      "namespace phonology {\n";
+  append_image<phonology::AmericanEnglish>("AmericanEnglish", source);
+  append_image<phonology::MetropolitanFrench>("MetropolitanFrench", source);
+  source += "\n}  // namespace phonology\n";
+  phonology::OutputWriter out(argv[1]);
+  out.write(source);
+  return 0;
+}